@@ -0,0 +1,143 @@
+#include "BakeTargetCommand.h"
+#include "BakedTargetData.h"
+#include "BlendNode.h"
+
+MStatus BakeTargetCommand::doIt(const MArgList &argList) {
+    MStatus status;
+
+    MArgDatabase argData(syntax(), argList, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    MSelectionList selection;
+    status = argData.getObjects(selection);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MObject oBlendNode;
+    status = selection.getDependNode(0, oBlendNode);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MFnDependencyNode fnBlendNode(oBlendNode, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    if (fnBlendNode.typeId() != BlendNode::id) {
+        MGlobal::displayError("bakeBlendTarget: " + fnBlendNode.name() +
+                              " is not a blendNode");
+        return MS::kInvalidParameter;
+    }
+
+    if (!argData.isFlagSet("-i")) {
+        MGlobal::displayError("bakeBlendTarget: -index must be given");
+        return MS::kInvalidParameter;
+    }
+    int index = argData.flagArgumentInt("-i", 0, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    int geometryIndex = 0;
+    if (argData.isFlagSet("-gi")) {
+        geometryIndex = argData.flagArgumentInt("-gi", 0, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+    if (geometryIndex < 0) {
+        MGlobal::displayError("bakeBlendTarget: -geometryIndex must not be "
+                              "negative");
+        return MS::kInvalidParameter;
+    }
+
+    // Get the target and the input geometry it's relative to
+    MPlug plugTargetMesh =
+        MPlug(oBlendNode, BlendNode::targetMesh).elementByLogicalIndex(index);
+    MObject oTargetMesh = plugTargetMesh.asMObject(&status);
+    if (!status || oTargetMesh.isNull()) {
+        MGlobal::displayError("bakeBlendTarget: nothing connected to " +
+                              plugTargetMesh.name());
+        return MS::kInvalidParameter;
+    }
+    MPlug plugInput = MPlug(oBlendNode, BlendNode::input);
+    MPlug plugInputGeom = plugInput.elementByLogicalIndex(geometryIndex)
+                              .child(BlendNode::inputGeom);
+    MObject oInputMesh = plugInputGeom.asMObject(&status);
+    if (!status || oInputMesh.isNull()) {
+        MGlobal::displayError("bakeBlendTarget: nothing connected to " +
+                              plugInputGeom.name());
+        return MS::kInvalidParameter;
+    }
+
+    // The live target blends into every geometry, once it's baked only the
+    // one it was baked against gets it
+    MIntArray inputIndices;
+    plugInput.getExistingArrayAttributeIndices(inputIndices);
+    for (unsigned int ii = 0; ii < inputIndices.length(); ++ii) {
+        if (inputIndices[ii] != geometryIndex &&
+            plugInput.elementByLogicalIndex(inputIndices[ii])
+                .child(BlendNode::inputGeom)
+                .isConnected()) {
+            MGlobal::displayWarning(
+                "bakeBlendTarget: " + plugTargetMesh.name() +
+                " will only be blended into " + plugInputGeom.name());
+            break;
+        }
+    }
+
+    MFnMesh fnTargetMesh(oTargetMesh, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MPointArray targetPoints;
+    status = fnTargetMesh.getPoints(targetPoints);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MFnMesh fnInputMesh(oInputMesh, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MPointArray inputPoints;
+    status = fnInputMesh.getPoints(inputPoints);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    if (targetPoints.length() != inputPoints.length()) {
+        MGlobal::displayError(
+            "bakeBlendTarget: target and input vertex counts differ");
+        return MS::kInvalidParameter;
+    }
+
+    // Bake the offsets into a new data object
+    MFnPluginData fnData;
+    MObject oData = fnData.create(BakedTargetData::id, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    BakedTargetData *bakedTarget =
+        static_cast<BakedTargetData *>(fnData.data(&status));
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    bakedTarget->bake(inputPoints, targetPoints);
+    bakedTarget->setGeometryIndex(geometryIndex);
+
+    // Store it and let go of the target mesh
+    MPlug plugBakedTarget =
+        MPlug(oBlendNode, BlendNode::bakedTarget).elementByLogicalIndex(index);
+    status = m_dgMod.newPlugValue(plugBakedTarget, oData);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MPlugArray sources;
+    plugTargetMesh.connectedTo(sources, true, false);
+    for (unsigned int ii = 0; ii < sources.length(); ++ii) {
+        status = m_dgMod.disconnect(sources[ii], plugTargetMesh);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+
+    setResult((int)bakedTarget->vertices().size());
+
+    return redoIt();
+}
+
+MStatus BakeTargetCommand::redoIt() { return m_dgMod.doIt(); }
+
+MStatus BakeTargetCommand::undoIt() { return m_dgMod.undoIt(); }
+
+bool BakeTargetCommand::isUndoable() const { return true; }
+
+void *BakeTargetCommand::creator() { return new BakeTargetCommand(); }
+
+MSyntax BakeTargetCommand::newSyntax() {
+    MSyntax syntax;
+
+    // Index of the targetMesh to bake
+    syntax.addFlag("-i", "-index", MSyntax::kLong);
+    // Logical index of the input geometry to take the offsets relative to
+    syntax.addFlag("-gi", "-geometryIndex", MSyntax::kLong);
+    // The blendNode
+    syntax.setObjectType(MSyntax::kSelectionList, 1, 1);
+    syntax.useSelectionAsDefault(true);
+
+    syntax.enableEdit(false);
+    syntax.enableQuery(false);
+
+    return syntax;
+}
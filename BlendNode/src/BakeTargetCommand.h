@@ -0,0 +1,43 @@
+#pragma once
+
+#include <maya/MArgDatabase.h>
+#include <maya/MDGModifier.h>
+#include <maya/MFnDependencyNode.h>
+#include <maya/MFnMesh.h>
+#include <maya/MFnPluginData.h>
+#include <maya/MGlobal.h>
+#include <maya/MIntArray.h>
+#include <maya/MObject.h>
+#include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
+#include <maya/MPointArray.h>
+#include <maya/MSelectionList.h>
+#include <maya/MSyntax.h>
+
+#include <maya/MPxCommand.h>
+
+/**
+ * Bake one of a blendNode's targetMesh connections into its bakedTarget
+ * attribute, then break the connection so the target mesh can be deleted.
+ *
+ * The offsets are taken relative to one of the deformer's input geometries,
+ * the first unless -geometryIndex is given, and the baked target is only
+ * blended into that geometry.
+ *
+ * Usage:
+ *   bakeBlendTarget -index 0 [-geometryIndex 0] blendNode1
+ */
+class BakeTargetCommand : public MPxCommand {
+  public:
+    BakeTargetCommand(){};
+    ~BakeTargetCommand(){};
+    virtual MStatus doIt(const MArgList &argList);
+    virtual MStatus redoIt();
+    virtual MStatus undoIt();
+    virtual bool isUndoable() const;
+    static void *creator();
+    static MSyntax newSyntax();
+
+  private:
+    MDGModifier m_dgMod;
+};
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <maya/MVector.h>
+
+#include "BakedTargetData.h"
+
+const MTypeId BakedTargetData::id(0x00000427);
+const MString BakedTargetData::typeName("blendBakedTarget");
+
+// Offsets smaller than this in every axis aren't stored
+static const double kMinOffset = 1e-6;
+static const double kQuantizedMax = 32767.0;
+
+void *BakedTargetData::creator() { return new BakedTargetData; }
+
+MStatus BakedTargetData::readASCII(const MArgList &args,
+                                   unsigned int &lastElement) {
+    MStatus status;
+
+    // <number of vertices> <step> followed by <vertex> <x> <y> <z> for each
+    // and optionally <geometry index>
+    unsigned int numVertices = args.asInt(lastElement++, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    m_step = (float)args.asDouble(lastElement++, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    // Reject a corrupt or negative count before making room for it, each
+    // vertex takes four arguments
+    if (lastElement > args.length() ||
+        numVertices > (args.length() - lastElement) / 4) {
+        return MS::kFailure;
+    }
+
+    m_vertices.resize(numVertices);
+    m_offsets.resize(numVertices * 3);
+    for (unsigned int ii = 0; ii < numVertices; ++ii) {
+        m_vertices[ii] = args.asInt(lastElement++, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            m_offsets[ii * 3 + axis] =
+                (int16_t)args.asInt(lastElement++, &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+        }
+    }
+
+    m_geometryIndex = 0;
+    if (lastElement < args.length()) {
+        m_geometryIndex = args.asInt(lastElement++, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+
+    return MS::kSuccess;
+}
+
+MStatus BakedTargetData::readBinary(std::istream &in, unsigned int length) {
+    // <uint32 number of vertices> <float step> <uint32 vertices...>
+    // <int16 offsets...> and optionally <uint32 geometry index>
+    uint32_t numVertices = 0;
+    in.read(reinterpret_cast<char *>(&numVertices), sizeof(numVertices));
+    in.read(reinterpret_cast<char *>(&m_step), sizeof(m_step));
+    size_t targetLength =
+        sizeof(numVertices) + sizeof(m_step) +
+        (size_t)numVertices * (sizeof(uint32_t) + 3 * sizeof(int16_t));
+    bool hasGeometryIndex = length == targetLength + sizeof(uint32_t);
+    if (!in || (length != targetLength && !hasGeometryIndex)) {
+        return MS::kFailure;
+    }
+
+    m_vertices.resize(numVertices);
+    m_offsets.resize(numVertices * 3);
+    if (numVertices > 0) {
+        in.read(reinterpret_cast<char *>(&m_vertices[0]),
+                numVertices * sizeof(uint32_t));
+        in.read(reinterpret_cast<char *>(&m_offsets[0]),
+                numVertices * 3 * sizeof(int16_t));
+    }
+    uint32_t geometryIndex = 0;
+    if (hasGeometryIndex) {
+        in.read(reinterpret_cast<char *>(&geometryIndex),
+                sizeof(geometryIndex));
+    }
+    m_geometryIndex = geometryIndex;
+
+    return in ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus BakedTargetData::writeASCII(std::ostream &out) {
+    // Every offset is scaled by the step, so write enough digits for it to
+    // read back exactly
+    std::streamsize precision =
+        out.precision(std::numeric_limits<float>::max_digits10);
+    out << m_vertices.size() << " " << m_step;
+    out.precision(precision);
+    for (size_t ii = 0; ii < m_vertices.size(); ++ii) {
+        out << " " << m_vertices[ii] << " " << m_offsets[ii * 3] << " "
+            << m_offsets[ii * 3 + 1] << " " << m_offsets[ii * 3 + 2];
+    }
+    out << " " << m_geometryIndex;
+
+    return out ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus BakedTargetData::writeBinary(std::ostream &out) {
+    uint32_t numVertices = m_vertices.size();
+    out.write(reinterpret_cast<const char *>(&numVertices),
+              sizeof(numVertices));
+    out.write(reinterpret_cast<const char *>(&m_step), sizeof(m_step));
+    if (numVertices > 0) {
+        out.write(reinterpret_cast<const char *>(&m_vertices[0]),
+                  numVertices * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char *>(&m_offsets[0]),
+                  numVertices * 3 * sizeof(int16_t));
+    }
+    uint32_t geometryIndex = m_geometryIndex;
+    out.write(reinterpret_cast<const char *>(&geometryIndex),
+              sizeof(geometryIndex));
+
+    return out ? MS::kSuccess : MS::kFailure;
+}
+
+void BakedTargetData::copy(const MPxData &other) {
+    const BakedTargetData &otherData =
+        static_cast<const BakedTargetData &>(other);
+    m_vertices      = otherData.m_vertices;
+    m_offsets       = otherData.m_offsets;
+    m_step          = otherData.m_step;
+    m_geometryIndex = otherData.m_geometryIndex;
+}
+
+MTypeId BakedTargetData::typeId() const { return id; }
+
+MString BakedTargetData::name() const { return typeName; }
+
+void BakedTargetData::bake(const MPointArray &inputPoints,
+                           const MPointArray &targetPoints) {
+    // Find the vertices that move and the largest offset component, which
+    // sets the quantization step
+    std::vector<unsigned int> vertices;
+    std::vector<double> offsets;
+    double maxOffset = 0.0;
+    for (unsigned int ii = 0; ii < inputPoints.length(); ++ii) {
+        MVector offset = targetPoints[ii] - inputPoints[ii];
+        if (std::fabs(offset.x) < kMinOffset &&
+            std::fabs(offset.y) < kMinOffset &&
+            std::fabs(offset.z) < kMinOffset) {
+            continue;
+        }
+
+        vertices.push_back(ii);
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            offsets.push_back(offset[axis]);
+            maxOffset = std::max(maxOffset, std::fabs(offset[axis]));
+        }
+    }
+
+    m_vertices.swap(vertices);
+    double step = maxOffset / kQuantizedMax;
+    m_step      = (float)step;
+    m_offsets.resize(offsets.size());
+    for (size_t ii = 0; ii < offsets.size(); ++ii) {
+        double quantized =
+            step > 0.0 ? std::floor(offsets[ii] / step + 0.5) : 0.0;
+        quantized =
+            std::max(-kQuantizedMax, std::min(kQuantizedMax, quantized));
+        m_offsets[ii] = (int16_t)quantized;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <maya/MArgList.h>
+#include <maya/MPointArray.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include <maya/MTypeId.h>
+
+#include <maya/MPxData.h>
+
+/**
+ * A blend target baked into the node instead of being read from a live mesh
+ * connection.
+ *
+ * Only the vertices the target moves are stored, each with its offset from
+ * the input mesh quantized to three 16-bit integers. The offsets are scaled by
+ * a single per-target step (the largest offset component divided by 32767),
+ * so a stored value q represents an offset of q * step.
+ *
+ * The offsets are relative to one of the node's input geometries, so the
+ * target also remembers which one and is only blended into that geometry. The
+ * index is written after the offsets and is optional when reading, targets
+ * saved without it were baked against the first input.
+ *
+ * Name:
+ *   blendBakedTarget
+ */
+class BakedTargetData : public MPxData {
+  public:
+    BakedTargetData() : m_step(0.0f), m_geometryIndex(0){};
+    virtual ~BakedTargetData(){};
+    static void *creator();
+
+    virtual MStatus readASCII(const MArgList &args,
+                              unsigned int &lastElement) override;
+    virtual MStatus readBinary(std::istream &in, unsigned int length) override;
+    virtual MStatus writeASCII(std::ostream &out) override;
+    virtual MStatus writeBinary(std::ostream &out) override;
+    virtual void copy(const MPxData &other) override;
+    virtual MTypeId typeId() const override;
+    virtual MString name() const override;
+
+    /**
+     * Store the offsets from inputPoints to targetPoints (which must be the
+     * same length), dropping the vertices that don't move.
+     */
+    void bake(const MPointArray &inputPoints, const MPointArray &targetPoints);
+
+    /**
+     * Indices of the vertices the target moves, ascending.
+     */
+    const std::vector<unsigned int> &vertices() const { return m_vertices; }
+    /**
+     * Three quantized offset components per vertex.
+     */
+    const std::vector<int16_t> &offsets() const { return m_offsets; }
+    float step() const { return m_step; }
+
+    /**
+     * Logical index of the input geometry the target was baked against.
+     */
+    unsigned int geometryIndex() const { return m_geometryIndex; }
+    void setGeometryIndex(unsigned int index) { m_geometryIndex = index; }
+
+    static const MTypeId id;
+    static const MString typeName;
+
+  private:
+    std::vector<unsigned int> m_vertices;
+    std::vector<int16_t> m_offsets;
+    float m_step;
+    unsigned int m_geometryIndex;
+};
@@ -1,16 +1,29 @@
-#include <maya/MFnPlugin.h>
+#include <algorithm>
+#include <memory>
 
+#include "BakedTargetData.h"
 #include "BlendNode.h"
+#include "ParallelFor.h"
+
+// Smallest number of points worth handing to a worker thread
+static const unsigned int kMinBlockSize = 4096;
 
 MTypeId BlendNode::id(0x00000002);
 MObject BlendNode::blendMesh;
 MObject BlendNode::blendWeight;
+MObject BlendNode::targetMesh;
+MObject BlendNode::targetWeight;
+MObject BlendNode::bakedTarget;
+MObject BlendNode::pointCacheFile;
+MObject BlendNode::pointCacheWeight;
+MObject BlendNode::time;
 
 void *BlendNode::creator() { return new BlendNode; }
 
 MStatus BlendNode::initialize() {
     MFnTypedAttribute typedAttribute;
     MFnNumericAttribute numericAttribute;
+    MFnUnitAttribute unitAttribute;
 
     blendMesh = typedAttribute.create("blendMesh", "blendMesh", MFnData::kMesh);
     addAttribute(blendMesh);
@@ -25,6 +38,51 @@ MStatus BlendNode::initialize() {
     addAttribute(blendWeight);
     attributeAffects(blendWeight, outputGeom);
 
+    // Any number of extra targets, each targetMesh element is blended in by
+    // the targetWeight element with the same index
+    targetMesh =
+        typedAttribute.create("targetMesh", "targetMesh", MFnData::kMesh);
+    typedAttribute.setArray(true);
+    addAttribute(targetMesh);
+    attributeAffects(targetMesh, outputGeom);
+
+    targetWeight =
+        numericAttribute.create("targetWeight", "tw", MFnNumericData::kFloat);
+    numericAttribute.setKeyable(true);
+    numericAttribute.setArray(true);
+    numericAttribute.setMin(0.0);
+    numericAttribute.setMax(1.0);
+    addAttribute(targetWeight);
+    attributeAffects(targetWeight, outputGeom);
+
+    // Targets baked with bakeBlendTarget, used when nothing is connected to
+    // the targetMesh with the same index
+    bakedTarget = typedAttribute.create("bakedTarget", "bakedTarget",
+                                        BakedTargetData::id);
+    typedAttribute.setArray(true);
+    typedAttribute.setHidden(true);
+    addAttribute(bakedTarget);
+    attributeAffects(bakedTarget, outputGeom);
+
+    // An animated target read from a point cache file at the current time
+    pointCacheFile = typedAttribute.create("pointCacheFile", "pcf",
+                                           MFnData::kString);
+    typedAttribute.setUsedAsFilename(true);
+    addAttribute(pointCacheFile);
+    attributeAffects(pointCacheFile, outputGeom);
+
+    pointCacheWeight = numericAttribute.create("pointCacheWeight", "pcw",
+                                               MFnNumericData::kFloat);
+    numericAttribute.setKeyable(true);
+    numericAttribute.setMin(0.0);
+    numericAttribute.setMax(1.0);
+    addAttribute(pointCacheWeight);
+    attributeAffects(pointCacheWeight, outputGeom);
+
+    time = unitAttribute.create("time", "tm", MFnUnitAttribute::kTime);
+    addAttribute(time);
+    attributeAffects(time, outputGeom);
+
     // Make the deformer weights paintable
     MGlobal::executeCommand(
         "makePaintable -attrType multiFloat -sm deformer blendNode weights;");
@@ -32,68 +90,384 @@ MStatus BlendNode::initialize() {
     return MS::kSuccess;
 }
 
-MStatus BlendNode::deform(MDataBlock &data, MItGeometry &itGeo,
-                                  const MMatrix &localToWorldMatrix,
-                                  unsigned int geomIndex) {
+namespace {
+
+// The targets that will move something, read once for every geometry
+struct ActiveTargets {
+    std::vector<int> indices;
+    std::vector<MObject> meshes;
+    std::vector<const BakedTargetData *> baked;
+    std::vector<float> weights;
+    // Point cache positions for the current time and its weight
+    const float *cachePoints;
+    float cacheWeight;
+};
+
+// What blending one geometry needs. Everything that goes through the Maya API
+// is gathered on the main thread, the blend only touches these buffers.
+struct BlendGeometry {
+    std::unique_ptr<MItGeometry> itGeo;
+    MPointArray points;
+    std::vector<int> indices;
+    const std::vector<float> *weights;
+    std::vector<const TargetCache::Target *> targets;
+    bool useCache;
+};
+
+// A block of one geometry's points
+struct BlendBlock {
+    unsigned int geometry;
+    unsigned int begin;
+    unsigned int end;
+};
+
+// Stands in for a target that doesn't apply to a geometry, it moves nothing
+const TargetCache::Target kNoTarget;
+
+} // namespace
+
+// Blend the points [begin, end) of one geometry towards the targets. Only
+// reads and writes the gathered buffers, so blocks of every geometry can run
+// at once.
+static void blendBlock(const ActiveTargets &active, BlendGeometry &geometry,
+                       unsigned int begin, unsigned int end) {
+    // Accumulate every target in one pass. The block sums the offsets of the
+    // targets that touch it, then applies the painted weight.
+    MPointArray &points               = geometry.points;
+    const std::vector<float> &weights = *geometry.weights;
+    const std::vector<int> &indices   = geometry.indices;
+    const float *cachePoints = geometry.useCache ? active.cachePoints : nullptr;
+    float pcw                = active.cacheWeight;
+    const std::vector<const TargetCache::Target *> &targets = geometry.targets;
+
+    std::vector<float> offsets((end - begin) * 3, 0.0f);
+    for (size_t tt = 0; tt < targets.size(); ++tt) {
+        const TargetCache::Target &target = *targets[tt];
+        float weight                      = active.weights[tt];
+
+        // Skip to the first of the target's points in this block
+        size_t kk = std::lower_bound(target.points.begin(),
+                                     target.points.end(), begin) -
+                    target.points.begin();
+        if (target.quantized.empty()) {
+            for (; kk < target.points.size() && target.points[kk] < end;
+                 ++kk) {
+                unsigned int local = (target.points[kk] - begin) * 3;
+                offsets[local] += target.offsets[kk * 3] * weight;
+                offsets[local + 1] += target.offsets[kk * 3 + 1] * weight;
+                offsets[local + 2] += target.offsets[kk * 3 + 2] * weight;
+            }
+        } else {
+            // Dequantize baked offsets as we go
+            float scale = target.step * weight;
+            for (; kk < target.points.size() && target.points[kk] < end;
+                 ++kk) {
+                unsigned int local = (target.points[kk] - begin) * 3;
+                offsets[local] += target.quantized[kk * 3] * scale;
+                offsets[local + 1] += target.quantized[kk * 3 + 1] * scale;
+                offsets[local + 2] += target.quantized[kk * 3 + 2] * scale;
+            }
+        }
+    }
+
+    for (unsigned int pp = begin; pp < end; ++pp) {
+        float w = weights[pp];
+        if (w == 0.0f) {
+            continue;
+        }
+
+        unsigned int local = (pp - begin) * 3;
+        MPoint &pt         = points[pp];
+        double dx          = offsets[local];
+        double dy          = offsets[local + 1];
+        double dz          = offsets[local + 2];
+        if (cachePoints != nullptr) {
+            // The cache stores every vertex, so it's a dense target
+            const float *cached = cachePoints + (size_t)indices[pp] * 3;
+            dx += (cached[0] - pt.x) * pcw;
+            dy += (cached[1] - pt.y) * pcw;
+            dz += (cached[2] - pt.z) * pcw;
+        }
+        pt.x += dx * w;
+        pt.y += dy * w;
+        pt.z += dz * w;
+    }
+}
+
+MStatus BlendNode::compute(const MPlug &plug, MDataBlock &data) {
+    if (!isDeformerOutput(plug, data)) {
+        return MPxDeformerNode::compute(plug, data);
+    }
+
     MStatus status;
 
+    std::vector<DeformerGeometry> geometries;
+    status = gatherGeometries(thisMObject(), data, geometries);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
     // Get the envelope and blend weight. The envelope is a magnifier provided
     // by the MPxDeformerNode that allows user to scale deformation.
     float env = data.inputValue(envelope).asFloat();
     float bw = data.inputValue(blendWeight).asFloat();
     bw *= env;
 
-    // Get the blend mesh
-    MObject mesh = data.inputValue(blendMesh).asMesh();
-    if (mesh.isNull()) {
-        // No blend mesh attached, do nothing.
-        return MS::kSuccess;
+    // Gather the targets that will actually move something. Targets with no
+    // weight are skipped entirely, their meshes aren't even evaluated. These
+    // are shared by every geometry.
+    ActiveTargets active;
+    if (bw != 0.0f) {
+        MObject mesh = data.inputValue(blendMesh).asMesh();
+        if (!mesh.isNull()) {
+            active.indices.push_back(TargetCache::kBlendMesh);
+            active.meshes.push_back(mesh);
+            active.baked.push_back(nullptr);
+            active.weights.push_back(bw);
+        }
     }
 
-    // Get the blend points
-    MFnMesh fnBlendMesh(mesh, &status);
+    MArrayDataHandle hTargetWeights =
+        data.inputArrayValue(targetWeight, &status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
-    MPointArray blendPoints;
-    fnBlendMesh.getPoints(blendPoints);
+    MPlug plugTargetMesh(thisMObject(), targetMesh);
+    MPlug plugBakedTarget(thisMObject(), bakedTarget);
+    unsigned int numTargetWeights = hTargetWeights.elementCount();
+    for (unsigned int ii = 0; ii < numTargetWeights;
+         ++ii, hTargetWeights.next()) {
+        float weight = hTargetWeights.inputValue().asFloat() * env;
+        if (weight == 0.0f) {
+            continue;
+        }
 
-    // Iterate over all points in mesh and perform the deformation
-    MPoint pt;
-    float w = 0.0f;
-    for (; !itGeo.isDone(); itGeo.next()) {
-        // Get the input point
-        pt = itGeo.position();
-        // Get the painted weight value
-        w = weightValue(data, geomIndex, itGeo.index());
+        unsigned int index = hTargetWeights.elementIndex();
+        MObject mesh =
+            data.inputValue(plugTargetMesh.elementByLogicalIndex(index))
+                .asMesh();
+        const BakedTargetData *baked = nullptr;
+        if (mesh.isNull()) {
+            // Fall back to the baked target
+            MObject oBakedTarget =
+                data.inputValue(plugBakedTarget.elementByLogicalIndex(index))
+                    .data();
+            if (oBakedTarget.isNull()) {
+                continue;
+            }
+            MFnPluginData fnData(oBakedTarget, &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            baked = static_cast<const BakedTargetData *>(fnData.constData());
+        }
 
-        // Perform the deformation
-        pt = pt + (blendPoints[itGeo.index()] - pt) * bw * w;
+        active.indices.push_back(index);
+        active.meshes.push_back(mesh);
+        active.baked.push_back(baked);
+        active.weights.push_back(weight);
+    }
 
-        // Set the new output point
-        itGeo.setPosition(pt);
+    // The point cache is read straight from the mapped file
+    active.cachePoints = nullptr;
+    active.cacheWeight = data.inputValue(pointCacheWeight).asFloat() * env;
+    if (active.cacheWeight != 0.0f) {
+        active.cachePoints = pointCacheFrame(data);
     }
 
-    // No need to set clean flag, MPxDeformerNode does this for us
-    return MS::kSuccess;
+    if (active.indices.empty() && active.cachePoints == nullptr) {
+        // No targets attached or all weighted off, the outputs are copies of
+        // the inputs
+        return setGeometriesClean(data, geometries);
+    }
+
+    // Everything that goes through the Maya API (the data block, the target
+    // meshes and the iterator) happens here, on the main thread
+    std::vector<BlendGeometry> blendGeometries(geometries.size());
+    std::vector<BlendBlock> blocks;
+    for (size_t gg = 0; gg < geometries.size(); ++gg) {
+        DeformerGeometry &geometry = geometries[gg];
+        BlendGeometry &blend       = blendGeometries[gg];
+        blend.itGeo.reset(new MItGeometry(geometry.hOutputGeom,
+                                          geometry.groupId, false, &status));
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+
+        MFnMesh fnInputMesh(geometry.hInputGeom.asMesh(), &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        unsigned int numVertices = fnInputMesh.numVertices();
+        // Ignore the point cache on meshes it wasn't cached for
+        blend.useCache = m_pointCache.numPoints() == numVertices;
+
+        // Get all the input points at once
+        status = blend.itGeo->allPositions(blend.points);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        unsigned int numPoints = blend.points.length();
+
+        // Vertex index of each point, the points are in iteration order which
+        // only matches the vertex order when the deformer affects every vertex
+        std::vector<int> &indices = blend.indices;
+        indices.resize(numPoints);
+        if (numPoints == numVertices) {
+            for (unsigned int ii = 0; ii < numPoints; ++ii) {
+                indices[ii] = ii;
+            }
+        } else {
+            MItGeometry &itGeo = *blend.itGeo;
+            unsigned int ii    = 0;
+            for (itGeo.reset(); !itGeo.isDone() && ii < numPoints;
+                 itGeo.next()) {
+                indices[ii++] = itGeo.index();
+            }
+        }
+
+        // Get the painted weights, these are only re-read when the weightList
+        // is dirtied
+        WeightCache &weightCache = m_weightCaches[geometry.geomIndex];
+        status = weightCache.update(data, geometry.geomIndex, indices);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        blend.weights = &weightCache.weights();
+
+        // Get the offsets to each active target, these are only recomputed
+        // when that target or the input geometry are dirtied. Baked targets
+        // only apply to the geometry they were baked against.
+        TargetCache &targetCache = m_targetCaches[geometry.geomIndex];
+        targetCache.setIndices(indices);
+        for (size_t tt = 0; tt < active.indices.size(); ++tt) {
+            if (active.baked[tt] != nullptr &&
+                active.baked[tt]->geometryIndex() != geometry.geomIndex) {
+                blend.targets.push_back(&kNoTarget);
+                continue;
+            }
+            if (active.baked[tt] == nullptr) {
+                status = targetCache.update(active.indices[tt],
+                                            active.meshes[tt], blend.points);
+                CHECK_MSTATUS_AND_RETURN_IT(status);
+            } else {
+                targetCache.updateBaked(active.indices[tt], *active.baked[tt]);
+            }
+            blend.targets.push_back(&targetCache.target(active.indices[tt]));
+        }
+
+        for (unsigned int begin = 0; begin < numPoints;
+             begin += kMinBlockSize) {
+            BlendBlock block = {(unsigned int)gg, begin,
+                                std::min(begin + kMinBlockSize, numPoints)};
+            blocks.push_back(block);
+        }
+    }
+
+    // One parallel pass over the blocks of every geometry, so a few large
+    // meshes and many small ones both spread over the threads
+    parallelFor(blocks.size(), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int bb = begin; bb < end; ++bb) {
+            const BlendBlock &block = blocks[bb];
+            blendBlock(active, blendGeometries[block.geometry], block.begin,
+                       block.end);
+        }
+    });
+
+    // Set the new output points, again on the main thread
+    for (size_t gg = 0; gg < blendGeometries.size(); ++gg) {
+        status = blendGeometries[gg].itGeo->setAllPositions(
+            blendGeometries[gg].points);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+
+    return setGeometriesClean(data, geometries);
 }
 
-MStatus initializePlugin(MObject obj) {
-    MStatus status;
-    MFnPlugin plugin(obj, "Samuel Evans-Powell", "1.0", "Any");
+MStatus BlendNode::setDependentsDirty(const MPlug &plug,
+                                      MPlugArray &plugArray) {
+    // Painting weights dirties the weightList, make sure the cached weights
+    // get re-read
+    int geomIndex;
+    if (WeightCache::isWeightPlug(plug, geomIndex)) {
+        std::map<unsigned int, WeightCache>::iterator it;
+        for (it = m_weightCaches.begin(); it != m_weightCaches.end(); ++it) {
+            if (geomIndex < 0 || it->first == (unsigned int)geomIndex) {
+                it->second.setDirty();
+            }
+        }
+    }
 
-    // Specify we are making a deformer node
-    status = plugin.registerNode("blendNode", BlendNode::id, BlendNode::creator,
-                                 BlendNode::initialize, MPxNode::kDeformerNode);
-    CHECK_MSTATUS_AND_RETURN_IT(status);
+    // The cached offsets depend on the targets and the input geometry
+    if (plug == blendMesh) {
+        setTargetDirty(TargetCache::kBlendMesh);
+    } else if (plug == targetMesh || plug == bakedTarget) {
+        if (plug.isElement()) {
+            setTargetDirty(plug.logicalIndex());
+        } else {
+            setTargetsDirty(-1);
+        }
+    } else if (plug == input || plug == inputGeom) {
+        MPlug element = plug.isChild() ? plug.parent() : plug;
+        setTargetsDirty(element.isElement() ? (int)element.logicalIndex() : -1);
+    }
 
-    return status;
+    return MPxDeformerNode::setDependentsDirty(plug, plugArray);
 }
 
-MStatus uninitializePlugin(MObject obj) {
-    MStatus status;
-    MFnPlugin plugin(obj);
+MStatus BlendNode::preEvaluation(const MDGContext &context,
+                                 const MEvaluationNode &evaluationNode) {
+    // setDependentsDirty isn't called while the evaluation manager is playing
+    // back, so check what it dirtied here as well
+    if (!context.isNormal()) {
+        return MPxDeformerNode::preEvaluation(context, evaluationNode);
+    }
 
-    status = plugin.deregisterNode(BlendNode::id);
-    CHECK_MSTATUS_AND_RETURN_IT(status);
+    if (evaluationNode.dirtyPlugExists(weightList) ||
+        evaluationNode.dirtyPlugExists(weights)) {
+        std::map<unsigned int, WeightCache>::iterator it;
+        for (it = m_weightCaches.begin(); it != m_weightCaches.end(); ++it) {
+            it->second.setDirty();
+        }
+    }
+
+    if (evaluationNode.dirtyPlugExists(blendMesh)) {
+        setTargetDirty(TargetCache::kBlendMesh);
+    }
+
+    // There's no telling which target or geometry was dirtied from here
+    if (evaluationNode.dirtyPlugExists(targetMesh) ||
+        evaluationNode.dirtyPlugExists(bakedTarget) ||
+        evaluationNode.dirtyPlugExists(inputGeom)) {
+        setTargetsDirty(-1);
+    }
+
+    return MPxDeformerNode::preEvaluation(context, evaluationNode);
+}
+
+const float *BlendNode::pointCacheFrame(MDataBlock &data) {
+    // Only (re)map the file when the path changes
+    MString path = data.inputValue(pointCacheFile).asString();
+    if (path != m_pointCacheFile) {
+        m_pointCacheFile = path;
+        m_pointCache.close();
+        if (path.length() > 0) {
+            MStatus status = m_pointCache.open(path);
+            if (!status) {
+                MGlobal::displayWarning(name() +
+                                        ": could not read point cache " + path);
+            }
+        }
+    }
 
-    return status;
+    if (!m_pointCache.isOpen()) {
+        return nullptr;
+    }
+
+    double frame = data.inputValue(time).asTime().as(MTime::uiUnit());
+    unsigned int frameIndex = m_pointCache.frameIndex(frame);
+    m_pointCache.prefetch(frameIndex);
+    return m_pointCache.points(frameIndex);
+}
+
+void BlendNode::setTargetsDirty(int geomIndex) {
+    std::map<unsigned int, TargetCache>::iterator it;
+    for (it = m_targetCaches.begin(); it != m_targetCaches.end(); ++it) {
+        if (geomIndex < 0 || it->first == (unsigned int)geomIndex) {
+            it->second.setAllDirty();
+        }
+    }
+}
+
+void BlendNode::setTargetDirty(int targetIndex) {
+    std::map<unsigned int, TargetCache>::iterator it;
+    for (it = m_targetCaches.begin(); it != m_targetCaches.end(); ++it) {
+        it->second.setDirty(targetIndex);
+    }
 }
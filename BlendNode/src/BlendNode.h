@@ -1,25 +1,50 @@
 #pragma once
 
+#include <map>
+#include <vector>
+
 #include <maya/MDataBlock.h>
+#include <maya/MDGContext.h>
 #include <maya/MDataHandle.h>
+#include <maya/MEvaluationNode.h>
 #include <maya/MGlobal.h>
 #include <maya/MItGeometry.h>
 #include <maya/MMatrix.h>
+#include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
 #include <maya/MPointArray.h>
 #include <maya/MStatus.h>
+#include <maya/MTime.h>
 
 #include <maya/MFnMesh.h>
 #include <maya/MFnNumericAttribute.h>
+#include <maya/MFnPluginData.h>
 #include <maya/MFnTypedAttribute.h>
+#include <maya/MFnUnitAttribute.h>
 
 #include <maya/MPxDeformerNode.h>
 
+#include "DeformerGeometry.h"
+#include "PointCache.h"
+#include "TargetCache.h"
+#include "WeightCache.h"
+
 /**
- * A node that blends two meshes according to a weight.
+ * A node that blends a mesh towards one or more target meshes according to
+ * their weights.
  *
  * Attributes:
  *   blendMesh (bm) - Mesh 
  *   blendWeight (bw) - float
+ *   targetMesh (targetMesh) - Mesh array, extra targets
+ *   targetWeight (tw) - float array, weight of the targetMesh with the same
+ *   index
+ *   bakedTarget (bakedTarget) - blendBakedTarget array, compressed targets
+ *   used in place of targetMeshes that aren't connected
+ *   pointCacheFile (pcf) - string, point cache file (see PointCache) with the
+ *   object space positions of every vertex for each frame
+ *   pointCacheWeight (pcw) - float
+ *   time (tm) - time, connect to time1.outTime to animate the point cache
  */
 class BlendNode : public MPxDeformerNode {
   public:
@@ -27,11 +52,44 @@ class BlendNode : public MPxDeformerNode {
     virtual ~BlendNode(){};
     static void *creator();
     static MStatus initialize();
-    virtual MStatus deform(MDataBlock &data, MItGeometry &itGeo,
-                           const MMatrix &localToWorldMatrix,
-                           unsigned int geomIndex) override;
+    virtual MStatus compute(const MPlug &plug, MDataBlock &data) override;
+    virtual MStatus setDependentsDirty(const MPlug &plug,
+                                       MPlugArray &plugArray) override;
+    virtual MStatus
+    preEvaluation(const MDGContext &context,
+                  const MEvaluationNode &evaluationNode) override;
 
     static MTypeId id;
     static MObject blendMesh;
     static MObject blendWeight;
+    static MObject targetMesh;
+    static MObject targetWeight;
+    static MObject bakedTarget;
+    static MObject pointCacheFile;
+    static MObject pointCacheWeight;
+    static MObject time;
+
+  private:
+    /**
+     * Points of the point cache at the current time, or nullptr if there is
+     * no point cache.
+     */
+    const float *pointCacheFrame(MDataBlock &data);
+    /**
+     * Mark every cached target of the given geometry index as needing to be
+     * recomputed, or those of every geometry when geomIndex is -1.
+     */
+    void setTargetsDirty(int geomIndex);
+    /**
+     * Mark the given target as needing to be recomputed for every geometry.
+     */
+    void setTargetDirty(int targetIndex);
+
+    // Cached painted weights for each input geometry index
+    std::map<unsigned int, WeightCache> m_weightCaches;
+    // Cached offsets to the targets for each input geometry index
+    std::map<unsigned int, TargetCache> m_targetCaches;
+    // Point cache file that was last asked for and its mapping
+    MString m_pointCacheFile;
+    PointCache m_pointCache;
 };
@@ -0,0 +1,44 @@
+#include "BakeTargetCommand.h"
+#include "BakedTargetData.h"
+#include "BlendNode.h"
+
+#include <maya/MFnPlugin.h>
+
+MStatus initializePlugin(MObject obj) {
+    MStatus status;
+    MFnPlugin plugin(obj, "Samuel Evans-Powell", "1.0", "Any");
+
+    // The data type has to exist before the node that uses it
+    status = plugin.registerData(BakedTargetData::typeName,
+                                 BakedTargetData::id,
+                                 BakedTargetData::creator);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    // Specify we are making a deformer node
+    status = plugin.registerNode("blendNode", BlendNode::id, BlendNode::creator,
+                                 BlendNode::initialize, MPxNode::kDeformerNode);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    status = plugin.registerCommand("bakeBlendTarget",
+                                    BakeTargetCommand::creator,
+                                    BakeTargetCommand::newSyntax);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    return status;
+}
+
+MStatus uninitializePlugin(MObject obj) {
+    MStatus status;
+    MFnPlugin plugin(obj);
+
+    status = plugin.deregisterCommand("bakeBlendTarget");
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    status = plugin.deregisterNode(BlendNode::id);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    status = plugin.deregisterData(BakedTargetData::id);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    return status;
+}
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "PointCache.h"
+
+static const uint32_t kVersion = 1;
+// Number of frames ahead of the current one the prefetch thread warms
+static const int64_t kPrefetchFrames = 8;
+// Touching one value every this many bytes faults in every page
+static const size_t kPageSize = 4096;
+
+PointCache::PointCache()
+    : m_header(nullptr), m_frames(nullptr), m_size(0),
+#ifdef _WIN32
+      m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr),
+#else
+      m_file(-1),
+#endif
+      m_stop(false), m_requested(-1), m_warmedBegin(0), m_warmedEnd(0) {
+}
+
+PointCache::~PointCache() { close(); }
+
+MStatus PointCache::open(const MString &path) {
+    close();
+
+    // Map the whole file read-only
+    const void *data = nullptr;
+#ifdef _WIN32
+    m_file = CreateFileA(path.asChar(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        close();
+        return MS::kFailure;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size)) {
+        close();
+        return MS::kFailure;
+    }
+    m_size = (size_t)size.QuadPart;
+    m_mapping =
+        CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping != nullptr) {
+        data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    m_file = ::open(path.asChar(), O_RDONLY);
+    if (m_file < 0) {
+        close();
+        return MS::kFailure;
+    }
+    struct stat info;
+    if (fstat(m_file, &info) != 0) {
+        close();
+        return MS::kFailure;
+    }
+    m_size = (size_t)info.st_size;
+    if (m_size > 0) {
+        data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_file, 0);
+        if (data == MAP_FAILED) {
+            data = nullptr;
+        }
+    }
+#endif
+    if (data == nullptr) {
+        close();
+        return MS::kFailure;
+    }
+    m_header = static_cast<const Header *>(data);
+
+    // Check the header before trusting any of the frames
+    if (m_size < sizeof(Header) ||
+        std::memcmp(m_header->magic, "BNPC", 4) != 0 ||
+        m_header->version != kVersion || m_header->numFrames == 0 ||
+        m_size - sizeof(Header) < (size_t)m_header->numFrames *
+                                      m_header->numPoints * 3 *
+                                      sizeof(float)) {
+        close();
+        return MS::kInvalidParameter;
+    }
+    m_frames = reinterpret_cast<const float *>(m_header + 1);
+    m_path   = path;
+
+    m_stop        = false;
+    m_requested   = -1;
+    m_warmedBegin = 0;
+    m_warmedEnd   = 0;
+    m_thread      = std::thread(&PointCache::prefetchLoop, this);
+
+    return MS::kSuccess;
+}
+
+void PointCache::close() {
+    if (m_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_one();
+        m_thread.join();
+    }
+
+#ifdef _WIN32
+    if (m_header != nullptr) {
+        UnmapViewOfFile(m_header);
+    }
+    if (m_mapping != nullptr) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_header != nullptr) {
+        munmap(const_cast<Header *>(m_header), m_size);
+    }
+    if (m_file >= 0) {
+        ::close(m_file);
+        m_file = -1;
+    }
+#endif
+
+    m_header = nullptr;
+    m_frames = nullptr;
+    m_size   = 0;
+    m_path   = MString();
+}
+
+unsigned int PointCache::numPoints() const {
+    return isOpen() ? m_header->numPoints : 0;
+}
+
+unsigned int PointCache::frameIndex(double frame) const {
+    double index = std::floor(frame - m_header->firstFrame + 0.5);
+    index = std::max(0.0, std::min(index, m_header->numFrames - 1.0));
+    return (unsigned int)index;
+}
+
+const float *PointCache::points(unsigned int frameIndex) const {
+    return m_frames + (size_t)frameIndex * m_header->numPoints * 3;
+}
+
+void PointCache::prefetch(unsigned int frameIndex) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_requested = (int64_t)frameIndex + 1;
+    }
+    m_condition.notify_one();
+}
+
+void PointCache::prefetchLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_condition.wait(lock, [this] { return m_stop || m_requested >= 0; });
+        if (m_stop) {
+            return;
+        }
+
+        int64_t begin = m_requested;
+        int64_t end =
+            std::min(begin + kPrefetchFrames, (int64_t)m_header->numFrames);
+        m_requested = -1;
+        lock.unlock();
+
+        // Only touch the frames that weren't warmed last time, so playing
+        // forwards warms one new frame per frame
+        for (int64_t ff = begin; ff < end; ++ff) {
+            if (ff < m_warmedBegin || ff >= m_warmedEnd) {
+                touch((unsigned int)ff);
+            }
+        }
+        m_warmedBegin = begin;
+        m_warmedEnd   = end;
+
+        lock.lock();
+    }
+}
+
+void PointCache::touch(unsigned int frameIndex) const {
+    const char *begin = reinterpret_cast<const char *>(points(frameIndex));
+    const char *end   = begin + (size_t)m_header->numPoints * 3 * sizeof(float);
+#ifndef _WIN32
+    // Let the kernel start reading ahead while we fault the pages in
+    uintptr_t pageBegin = (uintptr_t)begin & ~(uintptr_t)(kPageSize - 1);
+    madvise((void *)pageBegin, end - (const char *)pageBegin, MADV_WILLNEED);
+#endif
+    volatile char sink = 0;
+    for (const char *byte = begin; byte < end; byte += kPageSize) {
+        sink += *byte;
+    }
+    (void)sink;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+
+/**
+ * A frame-indexed binary point cache, memory-mapped so that the points for a
+ * frame can be read straight out of the file without copying them or
+ * building a mesh.
+ *
+ * File layout (little-endian):
+ *   char[4]  magic "BNPC"
+ *   uint32   version (1)
+ *   uint32   number of points
+ *   uint32   number of frames
+ *   float    first frame
+ *   float[]  x, y, z of every point for each frame in turn
+ *
+ * A background thread touches the pages of the frames after the last one
+ * read so that playback doesn't stall on page faults.
+ */
+class PointCache {
+  public:
+    PointCache();
+    ~PointCache();
+
+    /**
+     * Map the given file, closing any file that was open.
+     */
+    MStatus open(const MString &path);
+    void close();
+
+    bool isOpen() const { return m_header != nullptr; }
+    const MString &path() const { return m_path; }
+    unsigned int numPoints() const;
+
+    /**
+     * Index of the frame nearest the given time (in frames), clamped to the
+     * frames in the file.
+     */
+    unsigned int frameIndex(double frame) const;
+
+    /**
+     * The x, y, z of every point at the given frame index.
+     */
+    const float *points(unsigned int frameIndex) const;
+
+    /**
+     * Ask the prefetch thread to warm the frames after frameIndex. Returns
+     * immediately.
+     */
+    void prefetch(unsigned int frameIndex);
+
+  private:
+    // Not copyable, the mapping and the thread are owned
+    PointCache(const PointCache &);
+    PointCache &operator=(const PointCache &);
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t numPoints;
+        uint32_t numFrames;
+        float firstFrame;
+    };
+
+    void prefetchLoop();
+    void touch(unsigned int frameIndex) const;
+
+    MString m_path;
+    const Header *m_header;
+    const float *m_frames;
+    size_t m_size;
+#ifdef _WIN32
+    void *m_file;
+    void *m_mapping;
+#else
+    int m_file;
+#endif
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop;
+    // Next frame the prefetch thread should start from, -1 for none
+    int64_t m_requested;
+    // Frames [m_warmedBegin, m_warmedEnd) were touched last time
+    int64_t m_warmedBegin;
+    int64_t m_warmedEnd;
+};
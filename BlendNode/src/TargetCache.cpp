@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "TargetCache.h"
+
+// Offsets smaller than this in every axis are left out of the sparse targets
+static const float kMinOffset = 1e-6f;
+
+void TargetCache::setIndices(const std::vector<int> &indices) {
+    if (indices != m_indices) {
+        m_indices = indices;
+        setAllDirty();
+
+        int maxIndex =
+            indices.empty() ? -1
+                            : *std::max_element(indices.begin(), indices.end());
+        m_positions.assign(maxIndex + 1, -1);
+        for (unsigned int ii = 0; ii < indices.size(); ++ii) {
+            m_positions[indices[ii]] = ii;
+        }
+    }
+}
+
+MStatus TargetCache::update(int targetIndex, const MObject &oTargetMesh,
+                            const MPointArray &points) {
+    MStatus status;
+
+    Target &target = m_targets[targetIndex];
+    if (!target.dirty) {
+        return MS::kSuccess;
+    }
+
+    MFnMesh fnTargetMesh(oTargetMesh, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MPointArray targetPoints;
+    status = fnTargetMesh.getPoints(targetPoints);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    target.points.clear();
+    target.offsets.clear();
+    target.quantized.clear();
+    unsigned int numPoints = points.length();
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        MVector delta = targetPoints[m_indices[ii]] - points[ii];
+        if (std::fabs(delta.x) < kMinOffset &&
+            std::fabs(delta.y) < kMinOffset &&
+            std::fabs(delta.z) < kMinOffset) {
+            continue;
+        }
+
+        target.points.push_back(ii);
+        target.offsets.push_back((float)delta.x);
+        target.offsets.push_back((float)delta.y);
+        target.offsets.push_back((float)delta.z);
+    }
+
+    target.dirty = false;
+
+    return MS::kSuccess;
+}
+
+void TargetCache::updateBaked(int targetIndex,
+                              const BakedTargetData &bakedTarget) {
+    Target &target = m_targets[targetIndex];
+    if (!target.dirty) {
+        return;
+    }
+
+    // Baked targets are stored by vertex, find where each of the vertices we
+    // affect is in iteration order
+    const std::vector<unsigned int> &vertices = bakedTarget.vertices();
+    std::vector<std::pair<unsigned int, unsigned int>> points;
+    for (unsigned int kk = 0; kk < vertices.size(); ++kk) {
+        if (vertices[kk] < m_positions.size() &&
+            m_positions[vertices[kk]] >= 0) {
+            points.push_back(std::make_pair(m_positions[vertices[kk]], kk));
+        }
+    }
+    std::sort(points.begin(), points.end());
+
+    const std::vector<int16_t> &quantized = bakedTarget.offsets();
+    target.points.resize(points.size());
+    target.quantized.resize(points.size() * 3);
+    for (size_t ii = 0; ii < points.size(); ++ii) {
+        unsigned int kk              = points[ii].second;
+        target.points[ii]            = points[ii].first;
+        target.quantized[ii * 3]     = quantized[kk * 3];
+        target.quantized[ii * 3 + 1] = quantized[kk * 3 + 1];
+        target.quantized[ii * 3 + 2] = quantized[kk * 3 + 2];
+    }
+    target.offsets.clear();
+    target.step  = bakedTarget.step();
+    target.dirty = false;
+}
+
+void TargetCache::setAllDirty() {
+    std::map<int, Target>::iterator it;
+    for (it = m_targets.begin(); it != m_targets.end(); ++it) {
+        it->second.dirty = true;
+    }
+}
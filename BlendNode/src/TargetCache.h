@@ -0,0 +1,73 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <maya/MFnMesh.h>
+#include <maya/MObject.h>
+#include <maya/MPointArray.h>
+#include <maya/MStatus.h>
+
+#include "BakedTargetData.h"
+
+/**
+ * The offsets from the input points to each blend target for one input
+ * geometry. Each target is kept until it or the input geometry are dirtied,
+ * so while they are clean blending only needs the weights.
+ *
+ * Targets are stored sparsely as the points that the target moves and an
+ * offset for each of them, so a target that only touches a small part of the
+ * mesh only costs that much to blend. Offsets to live target meshes are
+ * stored as floats, baked targets keep their 16-bit quantized offsets and are
+ * dequantized as they are blended.
+ */
+class TargetCache {
+  public:
+    struct Target {
+        Target() : dirty(true), step(0.0f){};
+
+        bool dirty;
+        // Positions (in iteration order, ascending) of the points that move
+        std::vector<unsigned int> points;
+        // Three floats per moving point, for live targets
+        std::vector<float> offsets;
+        // Three quantized values per moving point and the offset each step
+        // represents, for baked targets
+        std::vector<int16_t> quantized;
+        float step;
+    };
+
+    // Index of the blendMesh target, targetMesh elements use their logical
+    // index
+    static const int kBlendMesh = -1;
+
+    /**
+     * Set the vertex index of each point the deformer affects, in iteration
+     * order. Every target is recomputed if these changed.
+     */
+    void setIndices(const std::vector<int> &indices);
+
+    /**
+     * Recompute the offsets to the given target if it was dirtied. points are
+     * the input points in iteration order.
+     */
+    MStatus update(int targetIndex, const MObject &oTargetMesh,
+                   const MPointArray &points);
+
+    /**
+     * Recompute the given target from baked data if it was dirtied.
+     */
+    void updateBaked(int targetIndex, const BakedTargetData &bakedTarget);
+
+    const Target &target(int targetIndex) { return m_targets[targetIndex]; }
+
+    void setDirty(int targetIndex) { m_targets[targetIndex].dirty = true; }
+    void setAllDirty();
+
+  private:
+    std::vector<int> m_indices;
+    // Position in iteration order of each vertex, -1 for vertices the
+    // deformer doesn't affect
+    std::vector<int> m_positions;
+    std::map<int, Target> m_targets;
+};
@@ -1,9 +1,27 @@
 #include <maya/MFnPlugin.h>
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include "BulgeDeformer.h"
+#include "BulgeKernel.h"
+#include "ParallelFor.h"
+#include "Timing.h"
+#include "VolumeSolver.h"
+
+// Smallest number of points worth handing to a worker thread
+static const unsigned int kMinBlockSize = 4096;
+// Number of points staged into float streams for the kernel at a time
+static const unsigned int kChunkSize = 256;
 
 MTypeId BulgeDeformer::id(0x00000423);
 MObject BulgeDeformer::aBulgeAmount;
+MObject BulgeDeformer::aBatched;
+MObject BulgeDeformer::aSmoothIterations;
+MObject BulgeDeformer::aBulgeTexture;
+MObject BulgeDeformer::aPreserveVolume;
+MObject BulgeDeformer::aTargetVolume;
 
 void *BulgeDeformer::creator() { return new BulgeDeformer; }
 
@@ -18,69 +36,443 @@ MStatus BulgeDeformer::initialize() {
     addAttribute(aBulgeAmount);
     attributeAffects(aBulgeAmount, outputGeom);
 
+    aBatched = numericAttribute.create("batched", "bat",
+                                       MFnNumericData::kBoolean, 1);
+    addAttribute(aBatched);
+    attributeAffects(aBatched, outputGeom);
+
+    aSmoothIterations = numericAttribute.create("smoothIterations", "si",
+                                                MFnNumericData::kInt, 0);
+    numericAttribute.setKeyable(true);
+    numericAttribute.setMin(0);
+    numericAttribute.setSoftMax(10);
+    addAttribute(aSmoothIterations);
+    attributeAffects(aSmoothIterations, outputGeom);
+
+    aBulgeTexture = numericAttribute.createColor("bulgeTexture", "btx");
+    numericAttribute.setDefault(1.0f, 1.0f, 1.0f);
+    addAttribute(aBulgeTexture);
+    attributeAffects(aBulgeTexture, outputGeom);
+
+    aPreserveVolume = numericAttribute.create("preserveVolume", "pv",
+                                              MFnNumericData::kBoolean, 0);
+    numericAttribute.setKeyable(true);
+    addAttribute(aPreserveVolume);
+    attributeAffects(aPreserveVolume, outputGeom);
+
+    aTargetVolume = numericAttribute.create("targetVolume", "tv",
+                                            MFnNumericData::kDouble, 0.0);
+    numericAttribute.setKeyable(true);
+    addAttribute(aTargetVolume);
+    attributeAffects(aTargetVolume, outputGeom);
+
     MGlobal::executeCommand(
         "makePaintable -attrType multiFloat -sm deformer bulgeMesh weights;");
 
     return MS::kSuccess;
 }
 
-MStatus BulgeDeformer::deform(MDataBlock &data, MItGeometry &itGeo,
-                              const MMatrix &localToWorldMatrix,
-                              unsigned int geomIndex) {
+namespace {
+
+// Attributes shared by every geometry, read once per compute
+struct BulgeSettings {
+    float bulgeAmount;
+    float env;
+    int smoothIterations;
+    bool preserveVolume;
+    double targetVolume;
+};
+
+// What the batched deform of one geometry needs. Everything that goes through
+// the Maya API is gathered on the main thread, the kernel only touches these
+// buffers.
+struct BulgeGeometry {
+    std::unique_ptr<MItGeometry> itGeo;
+    MPointArray points;
+    std::vector<int> indices;
+    const MFloatVectorArray *normals;
+    const WeightCache *weightCache;
+    const std::vector<float> *textureAmounts;
+    float scale;
+};
+
+// A block of one geometry's active points
+struct BulgeBlock {
+    unsigned int geometry;
+    unsigned int begin;
+    unsigned int end;
+};
+
+} // namespace
+
+// Solve for the bulge amount that gives the mesh the target volume instead.
+// Each vertex moves along its normal scaled by its weight (and texture
+// amount), vertices the deformer doesn't affect stay put.
+static MStatus solveBulgeAmount(MFnMesh &fnMesh, GeometryCache &cache,
+                                const BulgeGeometry &geometry,
+                                double targetVolume, float &bulgeAmount) {
     MStatus status;
 
-    // We use output*Value instead of input*Value here because we don't want
-    // Maya to perform a dependency graph (DG) evaluation, we already know the
-    // value returned from the output*Value functions is valid for reading
-    // because the MPxDeformerNode already performs a DG evaluation for us in
-    // it's compute function.
-    // From the documentation: "When implementing the compute method for a
-    // deformer, another consideration is that the input geometry attribute is
-    // not cached. This means that all of the inputs will evaluate each time
-    // MDataBlock::inputArrayValue is called on "inputGeom". If you only want a
-    // single inputGeometry, you can prevent unneeded evaluations by avoiding
-    // calls to MDataBlock.inputArrayValue. For example, use the technique shown
-    // in the above example or use MDataBlock::outputArrayValue."
-    // (http://download.autodesk.com/us/maya/2011help/api/class_m_px_deformer_node.html)
-
-    // Get handle to array
-    MArrayDataHandle hInput = data.outputArrayValue(input, &status);
+    const MFloatVectorArray &normals         = *geometry.normals;
+    const std::vector<int> &indices          = geometry.indices;
+    const std::vector<float> *textureAmounts = geometry.textureAmounts;
+    const std::vector<float> &weights        = geometry.weightCache->weights();
+    const std::vector<unsigned int> &active =
+        geometry.weightCache->activePoints();
+
+    unsigned int numVertices = normals.length();
+    std::vector<float> directions(numVertices * 3, 0.0f);
+    parallelFor(active.size(), kMinBlockSize, [&](unsigned int begin,
+                                                  unsigned int end) {
+        for (unsigned int ii = begin; ii < end; ++ii) {
+            unsigned int pp = active[ii];
+            unsigned int vv = indices[pp];
+            float w         = weights[pp];
+            if (textureAmounts) {
+                w *= (*textureAmounts)[vv];
+            }
+
+            MFloatVector normal    = normals[vv];
+            directions[vv * 3]     = normal.x * w;
+            directions[vv * 3 + 1] = normal.y * w;
+            directions[vv * 3 + 2] = normal.z * w;
+        }
+    });
+
+    const float *rawPoints = fnMesh.getRawPoints(&status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
-    // Move array handle to appropriate element
-    status = hInput.jumpToElement(geomIndex);
-    // Get data handle to array element
-    MDataHandle hInputElement = hInput.outputValue(&status);
-    // Get input geometry of array element
-    MObject oInputGeom = hInputElement.child(inputGeom).asMesh();
-
-    MFnMesh fnMesh(oInputGeom, &status);
+    const std::vector<int> &triangles = cache.triangles(fnMesh);
+    bulgeAmount = solveVolumeAmount(rawPoints, directions.data(), triangles,
+                                    targetVolume);
+
+    return MS::kSuccess;
+}
+
+// Deform the active points [begin, end) of one geometry. Only reads and
+// writes the gathered buffers, so blocks of every geometry can run at once.
+// Mesh points are stored as floats so staging them into float streams is
+// lossless.
+static void bulgeBlock(BulgeKernel kernel, BulgeGeometry &geometry,
+                       unsigned int begin, unsigned int end) {
+    MPointArray &points                      = geometry.points;
+    const std::vector<int> &indices          = geometry.indices;
+    const MFloatVectorArray &normals         = *geometry.normals;
+    const std::vector<float> *textureAmounts = geometry.textureAmounts;
+    const std::vector<float> &weights        = geometry.weightCache->weights();
+    const std::vector<unsigned int> &active =
+        geometry.weightCache->activePoints();
+
+    alignas(64) float x[kChunkSize], y[kChunkSize], z[kChunkSize];
+    alignas(64) float nx[kChunkSize], ny[kChunkSize], nz[kChunkSize];
+    alignas(64) float w[kChunkSize];
+
+    for (unsigned int chunk = begin; chunk < end; chunk += kChunkSize) {
+        unsigned int count = std::min(kChunkSize, end - chunk);
+        for (unsigned int kk = 0; kk < count; ++kk) {
+            unsigned int pp     = active[chunk + kk];
+            const MPoint &point = points[pp];
+            MFloatVector normal = normals[indices[pp]];
+            x[kk]               = (float)point.x;
+            y[kk]               = (float)point.y;
+            z[kk]               = (float)point.z;
+            nx[kk]              = normal.x;
+            ny[kk]              = normal.y;
+            nz[kk]              = normal.z;
+            w[kk]               = weights[pp];
+            if (textureAmounts) {
+                w[kk] *= (*textureAmounts)[indices[pp]];
+            }
+        }
+
+        kernel(x, y, z, nx, ny, nz, w, geometry.scale, count);
+
+        for (unsigned int kk = 0; kk < count; ++kk) {
+            MPoint &point = points[active[chunk + kk]];
+            point.x       = x[kk];
+            point.y       = y[kk];
+            point.z       = z[kk];
+        }
+    }
+}
+
+MStatus BulgeDeformer::compute(const MPlug &plug, MDataBlock &data) {
+    if (!isDeformerOutput(plug, data)) {
+        return MPxDeformerNode::compute(plug, data);
+    }
+
+    MStatus status;
+
+    std::vector<DeformerGeometry> geometries;
+    status = gatherGeometries(thisMObject(), data, geometries);
     CHECK_MSTATUS_AND_RETURN_IT(status);
-    MFloatVectorArray normals;
-    fnMesh.getVertexNormals(false, normals);
 
-    // Perform deformation
-    float bulgeAmount = data.inputValue(aBulgeAmount).asFloat();
-    float env = data.inputValue(envelope).asFloat();
-    MPoint point;
-    float w;
-    for (; !itGeo.isDone(); itGeo.next()) {
-        w = weightValue(data, geomIndex, itGeo.index());
+    BulgeSettings settings;
+    settings.bulgeAmount      = data.inputValue(aBulgeAmount).asFloat();
+    settings.env              = data.inputValue(envelope).asFloat();
+    settings.smoothIterations = data.inputValue(aSmoothIterations).asInt();
+    settings.preserveVolume   = data.inputValue(aPreserveVolume).asBool();
+    settings.targetVolume     = data.inputValue(aTargetVolume).asDouble();
+
+    // Per-vertex bulge amounts from the texture, if one is connected. These
+    // are only sampled again when the texture or the UVs change. The texture
+    // is sampled through the shading network rather than the data block, but
+    // the plug still has to be read so it is cleaned, otherwise later edits
+    // to the texture would stop propagating dirty to it.
+    data.inputValue(aBulgeTexture);
+    MString texturePlug;
+    bool hasTexture = getConnectedTexture(texturePlug);
+
+    // Volume preservation needs the batched data, so always takes that path
+    if (!data.inputValue(aBatched).asBool() && !settings.preserveVolume) {
+        TIME_SCOPE("bulgeMesh iterator deform");
+
+        // The original one geometry, one point at a time loop
+        for (size_t gg = 0; gg < geometries.size(); ++gg) {
+            DeformerGeometry &geometry = geometries[gg];
+            unsigned int geomIndex     = geometry.geomIndex;
+            MItGeometry itGeo(geometry.hOutputGeom, geometry.groupId, false,
+                              &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            MFnMesh fnMesh(geometry.hInputGeom.asMesh(), &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+
+            GeometryCache &cache = m_geometryCaches[geomIndex];
+            status               = cache.updateNormals(fnMesh);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            const MFloatVectorArray &normals =
+                settings.smoothIterations > 0
+                    ? cache.smoothedNormals(settings.smoothIterations)
+                    : cache.normals();
+
+            const std::vector<float> *textureAmounts = nullptr;
+            if (hasTexture) {
+                status = cache.updateTextureAmounts(fnMesh, texturePlug);
+                CHECK_MSTATUS_AND_RETURN_IT(status);
+                textureAmounts = &cache.textureAmounts();
+            }
+
+            MPoint point;
+            float w;
+            for (; !itGeo.isDone(); itGeo.next()) {
+                w = weightValue(data, geomIndex, itGeo.index());
+                if (textureAmounts) {
+                    w *= (*textureAmounts)[itGeo.index()];
+                }
 
-        point = itGeo.position();
+                point = itGeo.position();
 
-        // Deformation algorithm
-        point += normals[itGeo.index()] * bulgeAmount * w * env;
+                // Deformation algorithm
+                point += normals[itGeo.index()] * settings.bulgeAmount * w *
+                         settings.env;
 
-        itGeo.setPosition(point);
+                itGeo.setPosition(point);
+            }
+        }
+
+        return setGeometriesClean(data, geometries);
     }
 
-    return MS::kSuccess;
+    // Everything that goes through the Maya API (the data block, the mesh
+    // function set, the iterator and the shading network) happens here, on
+    // the main thread
+    std::vector<BulgeGeometry> bulgeGeometries(geometries.size());
+    std::vector<BulgeBlock> blocks;
+    unsigned int numPoints = 0;
+    for (size_t gg = 0; gg < geometries.size(); ++gg) {
+        DeformerGeometry &geometry = geometries[gg];
+        BulgeGeometry &bulge       = bulgeGeometries[gg];
+        unsigned int geomIndex     = geometry.geomIndex;
+        bulge.itGeo.reset(new MItGeometry(geometry.hOutputGeom,
+                                          geometry.groupId, false, &status));
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        MItGeometry &itGeo = *bulge.itGeo;
+        MFnMesh fnMesh(geometry.hInputGeom.asMesh(), &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+
+        // Only recompute the normals that changed since the last evaluation,
+        // and smooth out the normals of noisy meshes so the bulge doesn't
+        // pinch
+        GeometryCache &cache = m_geometryCaches[geomIndex];
+        status               = cache.updateNormals(fnMesh);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        bulge.normals = settings.smoothIterations > 0
+                            ? &cache.smoothedNormals(settings.smoothIterations)
+                            : &cache.normals();
+
+        bulge.textureAmounts = nullptr;
+        if (hasTexture) {
+            status = cache.updateTextureAmounts(fnMesh, texturePlug);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            bulge.textureAmounts = &cache.textureAmounts();
+        }
+
+        // Pull every point the deformer affects in one go
+        status = itGeo.allPositions(bulge.points);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        unsigned int numGeometryPoints = bulge.points.length();
+        numPoints += numGeometryPoints;
+
+        // The points come back in iteration order, which only lines up with
+        // the vertex indices when the deformer affects the whole mesh.
+        // Otherwise we have to ask the iterator which vertex each point
+        // belongs to.
+        std::vector<int> &indices = bulge.indices;
+        indices.resize(numGeometryPoints);
+        if (numGeometryPoints == (unsigned int)fnMesh.numVertices()) {
+            for (unsigned int ii = 0; ii < numGeometryPoints; ++ii) {
+                indices[ii] = ii;
+            }
+        } else {
+            unsigned int ii = 0;
+            for (itGeo.reset(); !itGeo.isDone() && ii < numGeometryPoints;
+                 itGeo.next()) {
+                indices[ii++] = itGeo.index();
+            }
+        }
+
+        // The painted weights are only re-read when the weightList is
+        // dirtied, and only points with a non-zero weight can move
+        WeightCache &weightCache = m_weightCaches[geomIndex];
+        status = weightCache.update(data, geomIndex, indices);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        bulge.weightCache = &weightCache;
+
+        float bulgeAmount = settings.bulgeAmount;
+        if (settings.preserveVolume) {
+            status = solveBulgeAmount(fnMesh, cache, bulge,
+                                      settings.targetVolume, bulgeAmount);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+        }
+        bulge.scale = bulgeAmount * settings.env;
+
+        unsigned int numActive = weightCache.activePoints().size();
+        for (unsigned int begin = 0; begin < numActive;
+             begin += kMinBlockSize) {
+            BulgeBlock block = {(unsigned int)gg, begin,
+                                std::min(begin + kMinBlockSize, numActive)};
+            blocks.push_back(block);
+        }
+    }
+
+    {
+        TIME_SCOPE(MString("bulgeMesh batched deform (") + bulgeKernelName() +
+                       " kernel)",
+                   numPoints);
+
+        // One parallel pass over the blocks of every geometry, so a few large
+        // meshes and many small ones both spread over the threads
+        BulgeKernel kernel = bulgeKernel();
+        parallelFor(blocks.size(), 1, [&](unsigned int begin,
+                                          unsigned int end) {
+            for (unsigned int bb = begin; bb < end; ++bb) {
+                const BulgeBlock &block = blocks[bb];
+                bulgeBlock(kernel, bulgeGeometries[block.geometry],
+                           block.begin, block.end);
+            }
+        });
+    }
+
+    // Write everything back at once, again on the main thread
+    for (size_t gg = 0; gg < bulgeGeometries.size(); ++gg) {
+        status = bulgeGeometries[gg].itGeo->setAllPositions(
+            bulgeGeometries[gg].points);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+
+    return setGeometriesClean(data, geometries);
+}
+
+MStatus BulgeDeformer::setDependentsDirty(const MPlug &plug,
+                                          MPlugArray &plugArray) {
+    // Painting weights dirties the weightList, make sure the cached weights
+    // get re-read
+    int geomIndex;
+    if (WeightCache::isWeightPlug(plug, geomIndex)) {
+        std::map<unsigned int, WeightCache>::iterator it;
+        for (it = m_weightCaches.begin(); it != m_weightCaches.end(); ++it) {
+            if (geomIndex < 0 || it->first == (unsigned int)geomIndex) {
+                it->second.setDirty();
+            }
+        }
+    }
+
+    // Anything upstream of the texture changing dirties our texture plug, the
+    // samples need redoing
+    if (plug == aBulgeTexture ||
+        (plug.isChild() && plug.parent() == aBulgeTexture)) {
+        std::map<unsigned int, GeometryCache>::iterator it;
+        for (it = m_geometryCaches.begin(); it != m_geometryCaches.end();
+             ++it) {
+            it->second.setTextureDirty();
+        }
+    }
+
+    // UVs can move without the topology changing, have them checked again
+    if (plug == input || plug == inputGeom) {
+        std::map<unsigned int, GeometryCache>::iterator it;
+        for (it = m_geometryCaches.begin(); it != m_geometryCaches.end();
+             ++it) {
+            it->second.setUVsDirty();
+        }
+    }
+
+    return MPxDeformerNode::setDependentsDirty(plug, plugArray);
+}
+
+MStatus BulgeDeformer::preEvaluation(const MDGContext &context,
+                                     const MEvaluationNode &evaluationNode) {
+    // setDependentsDirty isn't called while the evaluation manager is playing
+    // back, so check what it dirtied here as well
+    if (!context.isNormal()) {
+        return MPxDeformerNode::preEvaluation(context, evaluationNode);
+    }
+
+    if (evaluationNode.dirtyPlugExists(weightList) ||
+        evaluationNode.dirtyPlugExists(weights)) {
+        std::map<unsigned int, WeightCache>::iterator it;
+        for (it = m_weightCaches.begin(); it != m_weightCaches.end(); ++it) {
+            it->second.setDirty();
+        }
+    }
+
+    if (evaluationNode.dirtyPlugExists(aBulgeTexture)) {
+        std::map<unsigned int, GeometryCache>::iterator it;
+        for (it = m_geometryCaches.begin(); it != m_geometryCaches.end();
+             ++it) {
+            it->second.setTextureDirty();
+        }
+    }
+
+    if (evaluationNode.dirtyPlugExists(input) ||
+        evaluationNode.dirtyPlugExists(inputGeom)) {
+        std::map<unsigned int, GeometryCache>::iterator it;
+        for (it = m_geometryCaches.begin(); it != m_geometryCaches.end();
+             ++it) {
+            it->second.setUVsDirty();
+        }
+    }
+
+    return MPxDeformerNode::preEvaluation(context, evaluationNode);
+}
+
+bool BulgeDeformer::getConnectedTexture(MString &texturePlug) const {
+    MPlug plug(thisMObject(), aBulgeTexture);
+    MPlugArray sources;
+    if (!plug.connectedTo(sources, true, false) || sources.length() == 0) {
+        return false;
+    }
+
+    texturePlug = sources[0].name();
+    return true;
 }
 
 MStatus initializePlugin(MObject obj) {
     MStatus status;
     MFnPlugin plugin(obj, "Samuel Evans-Powell", "1.0", "Any");
 
+    // Use the fastest bulge kernel this CPU can run
+    selectBulgeKernel();
+
     // Specify we are making a deformer node
     status = plugin.registerNode(
         "bulgeMesh", BulgeDeformer::id, BulgeDeformer::creator,
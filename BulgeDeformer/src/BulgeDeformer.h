@@ -1,10 +1,16 @@
 #pragma once
 
+#include <map>
+
 #include <maya/MDataBlock.h>
+#include <maya/MDGContext.h>
 #include <maya/MDataHandle.h>
+#include <maya/MEvaluationNode.h>
 #include <maya/MGlobal.h>
 #include <maya/MItGeometry.h>
 #include <maya/MMatrix.h>
+#include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
 #include <maya/MPointArray.h>
 #include <maya/MStatus.h>
 
@@ -15,6 +21,10 @@
 
 #include <maya/MPxDeformerNode.h>
 
+#include "DeformerGeometry.h"
+#include "GeometryCache.h"
+#include "WeightCache.h"
+
 /**
  * A node that 'pushes' a mesh out along it's normals.
  *
@@ -23,6 +33,18 @@
  *
  * Attributes:
  *   bulgeAmount (amt) - float
+ *   batched (bat) - bool, read and write all points at once and deform them
+ *   on multiple threads rather than walking the geometry iterator one point
+ *   at a time. On by default.
+ *   smoothIterations (si) - int, number of Laplacian smoothing iterations to
+ *   run over the normals before bulging along them.
+ *   bulgeTexture (btx) - color, when a 2D texture is connected the bulge
+ *   amount of each vertex is scaled by the luminance of the texture at the
+ *   vertex's UV.
+ *   preserveVolume (pv) - bool, ignore bulgeAmount and instead find the
+ *   amount that gives the (closed) mesh the target volume.
+ *   targetVolume (tv) - double, volume to hold the mesh to when
+ *   preserveVolume is on.
  */
 class BulgeDeformer : public MPxDeformerNode {
   public:
@@ -30,10 +52,30 @@ class BulgeDeformer : public MPxDeformerNode {
     virtual ~BulgeDeformer(){};
     static void *creator();
     static MStatus initialize();
-    virtual MStatus deform(MDataBlock &data, MItGeometry &itGeo,
-                           const MMatrix &localToWorldMatrix,
-                           unsigned int geomIndex) override;
+    virtual MStatus compute(const MPlug &plug, MDataBlock &data) override;
+    virtual MStatus setDependentsDirty(const MPlug &plug,
+                                       MPlugArray &plugArray) override;
+    virtual MStatus
+    preEvaluation(const MDGContext &context,
+                  const MEvaluationNode &evaluationNode) override;
 
     static MTypeId id;
     static MObject aBulgeAmount;
+    static MObject aBatched;
+    static MObject aSmoothIterations;
+    static MObject aBulgeTexture;
+    static MObject aPreserveVolume;
+    static MObject aTargetVolume;
+
+  private:
+    /**
+     * Get the name of the plug connected to bulgeTexture, returns false when
+     * nothing is connected.
+     */
+    bool getConnectedTexture(MString &texturePlug) const;
+
+    // Cached normals and topology for each input geometry index
+    std::map<unsigned int, GeometryCache> m_geometryCaches;
+    // Cached painted weights for each input geometry index
+    std::map<unsigned int, WeightCache> m_weightCaches;
 };
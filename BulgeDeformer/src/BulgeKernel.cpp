@@ -0,0 +1,119 @@
+#include "BulgeKernel.h"
+
+#if defined(BULGE_X86_KERNELS) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+static BulgeKernel s_kernel       = bulgeKernelScalar;
+static const char *s_kernelName = "scalar";
+
+void bulgeKernelScalar(float *x, float *y, float *z, const float *nx,
+                       const float *ny, const float *nz, const float *w,
+                       float scale, unsigned int count) {
+    for (unsigned int ii = 0; ii < count; ++ii) {
+        float amount = w[ii] * scale;
+        x[ii] += nx[ii] * amount;
+        y[ii] += ny[ii] * amount;
+        z[ii] += nz[ii] * amount;
+    }
+}
+
+#ifdef BULGE_X86_KERNELS
+namespace {
+
+struct CpuFeatures {
+    bool sse42;
+    bool avx2;
+    bool avx512;
+};
+
+CpuFeatures detectCpuFeatures() {
+    CpuFeatures features = {false, false, false};
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    features.sse42 = (info[2] & (1 << 20)) != 0;
+    bool fma       = (info[2] & (1 << 12)) != 0;
+    bool osxsave   = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || maxLeaf < 7) {
+        return features;
+    }
+
+    // The OS also has to save the wider registers on a context switch
+    unsigned long long xcr0 = _xgetbv(0);
+    bool ymmState           = (xcr0 & 0x6) == 0x6;
+    bool zmmState           = (xcr0 & 0xe6) == 0xe6;
+
+    __cpuidex(info, 7, 0);
+    features.avx2   = ymmState && fma && (info[1] & (1 << 5)) != 0;
+    features.avx512 = zmmState && (info[1] & (1 << 16)) != 0;
+#else
+    __builtin_cpu_init();
+    features.sse42 = __builtin_cpu_supports("sse4.2") != 0;
+    features.avx2  = __builtin_cpu_supports("avx2") != 0 &&
+                    __builtin_cpu_supports("fma") != 0;
+    features.avx512 = __builtin_cpu_supports("avx512f") != 0;
+#endif
+    return features;
+}
+
+} // namespace
+#endif
+
+void selectBulgeKernel() {
+    s_kernel     = bulgeKernelScalar;
+    s_kernelName = "scalar";
+
+#ifdef BULGE_X86_KERNELS
+    CpuFeatures features = detectCpuFeatures();
+    if (features.avx512) {
+        s_kernel     = bulgeKernelAVX512;
+        s_kernelName = "AVX-512";
+    } else if (features.avx2) {
+        s_kernel     = bulgeKernelAVX2;
+        s_kernelName = "AVX2";
+    } else if (features.sse42) {
+        s_kernel     = bulgeKernelSSE42;
+        s_kernelName = "SSE4.2";
+    }
+#endif
+}
+
+BulgeKernel bulgeKernel() { return s_kernel; }
+
+const char *bulgeKernelName() { return s_kernelName; }
+
+unsigned int supportedBulgeKernels(BulgeKernel *kernels, const char **names,
+                                   unsigned int maxKernels) {
+    BulgeKernel supported[4];
+    const char *supportedNames[4];
+    unsigned int numSupported = 0;
+    supported[numSupported]        = bulgeKernelScalar;
+    supportedNames[numSupported++] = "scalar";
+
+#ifdef BULGE_X86_KERNELS
+    CpuFeatures features = detectCpuFeatures();
+    if (features.sse42) {
+        supported[numSupported]        = bulgeKernelSSE42;
+        supportedNames[numSupported++] = "SSE4.2";
+    }
+    if (features.avx2) {
+        supported[numSupported]        = bulgeKernelAVX2;
+        supportedNames[numSupported++] = "AVX2";
+    }
+    if (features.avx512) {
+        supported[numSupported]        = bulgeKernelAVX512;
+        supportedNames[numSupported++] = "AVX-512";
+    }
+#endif
+
+    for (unsigned int ii = 0; ii < numSupported && ii < maxKernels; ++ii) {
+        kernels[ii] = supported[ii];
+        names[ii]   = supportedNames[ii];
+    }
+    return numSupported;
+}
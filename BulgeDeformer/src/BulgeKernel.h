@@ -0,0 +1,52 @@
+#pragma once
+
+/**
+ * Offset points along their normals, scaled by a per-point weight:
+ *
+ *   p[i] += n[i] * w[i] * scale
+ *
+ * The points, normals and weights are separate float streams
+ * (structure-of-arrays) of length count. x, y and z are updated in place.
+ */
+typedef void (*BulgeKernel)(float *x, float *y, float *z, const float *nx,
+                            const float *ny, const float *nz, const float *w,
+                            float scale, unsigned int count);
+
+void bulgeKernelScalar(float *x, float *y, float *z, const float *nx,
+                       const float *ny, const float *nz, const float *w,
+                       float scale, unsigned int count);
+
+#ifdef BULGE_X86_KERNELS
+// Each of these lives in its own translation unit compiled for that
+// instruction set, they must only be called on CPUs that support it.
+void bulgeKernelSSE42(float *x, float *y, float *z, const float *nx,
+                      const float *ny, const float *nz, const float *w,
+                      float scale, unsigned int count);
+void bulgeKernelAVX2(float *x, float *y, float *z, const float *nx,
+                     const float *ny, const float *nz, const float *w,
+                     float scale, unsigned int count);
+void bulgeKernelAVX512(float *x, float *y, float *z, const float *nx,
+                       const float *ny, const float *nz, const float *w,
+                       float scale, unsigned int count);
+#endif
+
+/**
+ * Pick the widest kernel the CPU supports. Called once when the plugin is
+ * loaded.
+ */
+void selectBulgeKernel();
+
+/**
+ * The kernel picked by selectBulgeKernel (the scalar kernel until then) and
+ * its name, for reporting.
+ */
+BulgeKernel bulgeKernel();
+const char *bulgeKernelName();
+
+/**
+ * Every kernel the CPU supports, the scalar kernel first, and their names.
+ * Fills in at most maxKernels of each and returns how many there are, for
+ * checking the vectorised kernels against the scalar one.
+ */
+unsigned int supportedBulgeKernels(BulgeKernel *kernels, const char **names,
+                                   unsigned int maxKernels);
@@ -0,0 +1,26 @@
+#include <immintrin.h>
+
+#include "BulgeKernel.h"
+
+void bulgeKernelAVX2(float *x, float *y, float *z, const float *nx,
+                     const float *ny, const float *nz, const float *w,
+                     float scale, unsigned int count) {
+    __m256 vScale   = _mm256_set1_ps(scale);
+    unsigned int ii = 0;
+    for (; ii + 8 <= count; ii += 8) {
+        __m256 amount = _mm256_mul_ps(_mm256_loadu_ps(w + ii), vScale);
+        _mm256_storeu_ps(x + ii, _mm256_fmadd_ps(_mm256_loadu_ps(nx + ii),
+                                                 amount,
+                                                 _mm256_loadu_ps(x + ii)));
+        _mm256_storeu_ps(y + ii, _mm256_fmadd_ps(_mm256_loadu_ps(ny + ii),
+                                                 amount,
+                                                 _mm256_loadu_ps(y + ii)));
+        _mm256_storeu_ps(z + ii, _mm256_fmadd_ps(_mm256_loadu_ps(nz + ii),
+                                                 amount,
+                                                 _mm256_loadu_ps(z + ii)));
+    }
+
+    // Leftover points
+    bulgeKernelScalar(x + ii, y + ii, z + ii, nx + ii, ny + ii, nz + ii,
+                      w + ii, scale, count - ii);
+}
@@ -0,0 +1,30 @@
+#include <immintrin.h>
+
+#include "BulgeKernel.h"
+
+void bulgeKernelAVX512(float *x, float *y, float *z, const float *nx,
+                       const float *ny, const float *nz, const float *w,
+                       float scale, unsigned int count) {
+    __m512 vScale = _mm512_set1_ps(scale);
+    for (unsigned int ii = 0; ii < count; ii += 16) {
+        // Mask off the lanes past the end on the last iteration
+        unsigned int remaining = count - ii;
+        __mmask16 mask =
+            remaining >= 16 ? 0xffff : (__mmask16)((1u << remaining) - 1);
+
+        __m512 amount =
+            _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, w + ii), vScale);
+        _mm512_mask_storeu_ps(
+            x + ii, mask,
+            _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, nx + ii), amount,
+                            _mm512_maskz_loadu_ps(mask, x + ii)));
+        _mm512_mask_storeu_ps(
+            y + ii, mask,
+            _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, ny + ii), amount,
+                            _mm512_maskz_loadu_ps(mask, y + ii)));
+        _mm512_mask_storeu_ps(
+            z + ii, mask,
+            _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, nz + ii), amount,
+                            _mm512_maskz_loadu_ps(mask, z + ii)));
+    }
+}
@@ -0,0 +1,26 @@
+#include <nmmintrin.h>
+
+#include "BulgeKernel.h"
+
+void bulgeKernelSSE42(float *x, float *y, float *z, const float *nx,
+                      const float *ny, const float *nz, const float *w,
+                      float scale, unsigned int count) {
+    __m128 vScale   = _mm_set1_ps(scale);
+    unsigned int ii = 0;
+    for (; ii + 4 <= count; ii += 4) {
+        __m128 amount = _mm_mul_ps(_mm_loadu_ps(w + ii), vScale);
+        _mm_storeu_ps(x + ii,
+                      _mm_add_ps(_mm_loadu_ps(x + ii),
+                                 _mm_mul_ps(_mm_loadu_ps(nx + ii), amount)));
+        _mm_storeu_ps(y + ii,
+                      _mm_add_ps(_mm_loadu_ps(y + ii),
+                                 _mm_mul_ps(_mm_loadu_ps(ny + ii), amount)));
+        _mm_storeu_ps(z + ii,
+                      _mm_add_ps(_mm_loadu_ps(z + ii),
+                                 _mm_mul_ps(_mm_loadu_ps(nz + ii), amount)));
+    }
+
+    // Leftover points
+    bulgeKernelScalar(x + ii, y + ii, z + ii, nx + ii, ny + ii, nz + ii,
+                      w + ii, scale, count - ii);
+}
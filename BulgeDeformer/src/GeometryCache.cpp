@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cstring>
+
+#include <maya/MVector.h>
+
+#include "GeometryCache.h"
+#include "ParallelFor.h"
+
+// When more than this fraction of the points moved it is cheaper to let Maya
+// recompute every normal than to patch them up one vertex at a time
+static const unsigned int kPartialUpdateDivisor = 8;
+
+// Smallest number of vertices worth smoothing on a separate thread
+static const unsigned int kMinSmoothBlockSize = 2048;
+
+// 64-bit FNV-1a over 32-bit words
+static const uint64_t kHashOffset = 14695981039346656037ULL;
+static const uint64_t kHashPrime  = 1099511628211ULL;
+
+static uint64_t hashWords(uint64_t hash, const void *data, size_t numWords) {
+    const uint32_t *words = static_cast<const uint32_t *>(data);
+    for (size_t ii = 0; ii < numWords; ++ii) {
+        hash = (hash ^ words[ii]) * kHashPrime;
+    }
+    return hash;
+}
+
+// Hash every element of a Maya array of 32-bit values
+template <typename Array>
+static uint64_t hashArray(uint64_t hash, Array &array) {
+    for (unsigned int ii = 0; ii < array.length(); ++ii) {
+        hash = hashWords(hash, &array[ii], 1);
+    }
+    return hash;
+}
+
+// Start of a Maya array's storage, or null if it's empty
+static const float *arrayData(MFloatArray &array) {
+    return array.length() > 0 ? &array[0] : nullptr;
+}
+static const int *arrayData(MIntArray &array) {
+    return array.length() > 0 ? &array[0] : nullptr;
+}
+
+MStatus GeometryCache::updateNormals(MFnMesh &fnMesh) {
+    MStatus status;
+
+    unsigned int numVertices = fnMesh.numVertices();
+    const float *rawPoints   = fnMesh.getRawPoints(&status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    // Topology key
+    MIntArray counts, connects;
+    status = fnMesh.getVertices(counts, connects);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    uint64_t topologyHash = hashWords(kHashOffset, &numVertices, 1);
+    topologyHash          = hashArray(topologyHash, counts);
+    topologyHash          = hashArray(topologyHash, connects);
+
+    if (!m_valid || topologyHash != m_topologyHash) {
+        buildAdjacency(numVertices, counts, connects);
+        m_topologyHash   = topologyHash;
+        m_trianglesValid = false;
+        return updateAllNormals(fnMesh, rawPoints);
+    }
+
+    // Same topology, have the points changed?
+    uint64_t pointsHash = hashWords(kHashOffset, rawPoints, numVertices * 3);
+    if (pointsHash == m_pointsHash) {
+        return MS::kSuccess;
+    }
+
+    std::vector<unsigned int> moved;
+    unsigned int maxMoved = numVertices / kPartialUpdateDivisor;
+    for (unsigned int ii = 0; ii < numVertices; ++ii) {
+        if (memcmp(&rawPoints[ii * 3], &m_points[ii * 3], 3 * sizeof(float))) {
+            moved.push_back(ii);
+            if (moved.size() > maxMoved) {
+                // Too many to be worth patching up
+                return updateAllNormals(fnMesh, rawPoints);
+            }
+        }
+    }
+
+    status = updateMovedNormals(fnMesh, rawPoints, moved);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    m_pointsHash = pointsHash;
+
+    return MS::kSuccess;
+}
+
+void GeometryCache::buildAdjacency(unsigned int numVertices,
+                                   const MIntArray &counts,
+                                   const MIntArray &connects) {
+    // Faces around each vertex first...
+    std::vector<unsigned int> faceOffsets(numVertices + 1, 0);
+    for (unsigned int ii = 0; ii < connects.length(); ++ii) {
+        ++faceOffsets[connects[ii] + 1];
+    }
+    for (unsigned int ii = 0; ii < numVertices; ++ii) {
+        faceOffsets[ii + 1] += faceOffsets[ii];
+    }
+
+    // ...stored as the offset of the face's first vertex in connects
+    std::vector<unsigned int> faceStarts(connects.length());
+    std::vector<unsigned int> vertexFaces(connects.length());
+    std::vector<unsigned int> fill(faceOffsets.begin(), faceOffsets.end() - 1);
+    unsigned int faceStart = 0;
+    for (unsigned int ff = 0; ff < counts.length(); ++ff) {
+        for (int jj = 0; jj < counts[ff]; ++jj) {
+            vertexFaces[fill[connects[faceStart + jj]]++] = ff;
+        }
+        faceStarts[ff] = faceStart;
+        faceStart += counts[ff];
+    }
+
+    // ...then every other vertex on those faces
+    m_adjacencyOffsets.assign(1, 0);
+    m_adjacencyOffsets.reserve(numVertices + 1);
+    m_adjacency.clear();
+    for (unsigned int vv = 0; vv < numVertices; ++vv) {
+        size_t first = m_adjacency.size();
+        for (unsigned int kk = faceOffsets[vv]; kk < faceOffsets[vv + 1];
+             ++kk) {
+            unsigned int ff = vertexFaces[kk];
+            for (int jj = 0; jj < counts[ff]; ++jj) {
+                unsigned int neighbour = connects[faceStarts[ff] + jj];
+                if (neighbour != vv) {
+                    m_adjacency.push_back(neighbour);
+                }
+            }
+        }
+        std::sort(m_adjacency.begin() + first, m_adjacency.end());
+        m_adjacency.erase(
+            std::unique(m_adjacency.begin() + first, m_adjacency.end()),
+            m_adjacency.end());
+        m_adjacencyOffsets.push_back(m_adjacency.size());
+    }
+}
+
+MStatus GeometryCache::updateAllNormals(MFnMesh &fnMesh,
+                                        const float *rawPoints) {
+    MStatus status;
+
+    status = fnMesh.getVertexNormals(false, m_normals);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    unsigned int numFloats = fnMesh.numVertices() * 3;
+    m_points.assign(rawPoints, rawPoints + numFloats);
+    m_pointsHash = hashWords(kHashOffset, rawPoints, numFloats);
+    m_valid      = true;
+    ++m_normalsVersion;
+
+    return MS::kSuccess;
+}
+
+MStatus GeometryCache::updateMovedNormals(
+    MFnMesh &fnMesh, const float *rawPoints,
+    const std::vector<unsigned int> &moved) {
+    MStatus status;
+
+    // A moved vertex changes the normal of every face it is on, and so the
+    // normal of every vertex on those faces
+    std::vector<unsigned int> affected(moved.begin(), moved.end());
+    for (size_t ii = 0; ii < moved.size(); ++ii) {
+        unsigned int vv = moved[ii];
+        affected.insert(affected.end(),
+                        m_adjacency.begin() + m_adjacencyOffsets[vv],
+                        m_adjacency.begin() + m_adjacencyOffsets[vv + 1]);
+        memcpy(&m_points[vv * 3], &rawPoints[vv * 3], 3 * sizeof(float));
+    }
+    std::sort(affected.begin(), affected.end());
+    affected.erase(std::unique(affected.begin(), affected.end()),
+                   affected.end());
+
+    MVector normal;
+    for (size_t ii = 0; ii < affected.size(); ++ii) {
+        status = fnMesh.getVertexNormal(affected[ii], false, normal);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        m_normals[affected[ii]] = normal;
+    }
+    ++m_normalsVersion;
+
+    return MS::kSuccess;
+}
+
+const MFloatVectorArray &
+GeometryCache::smoothedNormals(unsigned int iterations) {
+    if (m_smoothedVersion == m_normalsVersion &&
+        m_smoothIterations == iterations && m_smoothed) {
+        return *m_smoothed;
+    }
+
+    unsigned int numVertices = m_normals.length();
+    m_smoothBuffers[0]       = m_normals;
+    m_smoothBuffers[1].setLength(numVertices);
+
+    // Ping-pong between the two buffers, reading the previous iteration and
+    // writing the next
+    unsigned int current = 0;
+    for (unsigned int iteration = 0; iteration < iterations; ++iteration) {
+        const MFloatVectorArray &source = m_smoothBuffers[current];
+        MFloatVectorArray &target       = m_smoothBuffers[1 - current];
+        parallelFor(numVertices, kMinSmoothBlockSize,
+                    [&](unsigned int begin, unsigned int end) {
+            for (unsigned int vv = begin; vv < end; ++vv) {
+                unsigned int first = m_adjacencyOffsets[vv];
+                unsigned int last  = m_adjacencyOffsets[vv + 1];
+                if (first == last) {
+                    target[vv] = source[vv];
+                    continue;
+                }
+
+                MFloatVector average;
+                for (unsigned int kk = first; kk < last; ++kk) {
+                    average += source[m_adjacency[kk]];
+                }
+                average = average * (1.0f / (last - first));
+
+                target[vv] = ((source[vv] + average) * 0.5f).normal();
+            }
+        });
+        current = 1 - current;
+    }
+
+    m_smoothed         = &m_smoothBuffers[current];
+    m_smoothedVersion  = m_normalsVersion;
+    m_smoothIterations = iterations;
+
+    return *m_smoothed;
+}
+
+MStatus GeometryCache::updateTextureAmounts(MFnMesh &fnMesh,
+                                           const MString &texturePlug) {
+    MStatus status;
+
+    // The UVs are only read again when the input geometry was dirtied, its
+    // topology (which updateNormals keeps hashed) changed or UVs were added
+    // or removed. Reading them hashes them, so the texture is only sampled
+    // again if they actually moved.
+    unsigned int numVertices = fnMesh.numVertices();
+    int numUVs               = fnMesh.numUVs();
+    if (m_uvsDirty || m_uvTopologyHash != m_topologyHash ||
+        m_numUVs != numUVs || m_vertexUs.length() != numVertices) {
+        MFloatArray us, vs;
+        status = fnMesh.getUVs(us, vs);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        MIntArray uvCounts, uvIds;
+        status = fnMesh.getAssignedUVs(uvCounts, uvIds);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        MIntArray counts, connects;
+        status = fnMesh.getVertices(counts, connects);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+
+        if (m_vertexUVs.update(numVertices, arrayData(us), arrayData(vs),
+                               us.length(), arrayData(counts),
+                               arrayData(connects), counts.length(),
+                               arrayData(uvCounts), arrayData(uvIds)) ||
+            m_vertexUs.length() != numVertices) {
+            const std::vector<float> &vertexUs = m_vertexUVs.us();
+            const std::vector<float> &vertexVs = m_vertexUVs.vs();
+            m_vertexUs.setLength(numVertices);
+            m_vertexVs.setLength(numVertices);
+            for (unsigned int ii = 0; ii < numVertices; ++ii) {
+                m_vertexUs[ii] = vertexUs[ii];
+                m_vertexVs[ii] = vertexVs[ii];
+            }
+            m_textureDirty = true;
+        }
+
+        m_uvTopologyHash = m_topologyHash;
+        m_numUVs         = numUVs;
+        m_uvsDirty       = false;
+    }
+
+    if (!m_textureDirty && texturePlug == m_texturePlug) {
+        return MS::kSuccess;
+    }
+
+    // Sample every vertex in one call
+    MFloatMatrix cameraMatrix;
+    MFloatVectorArray colors, transparencies;
+    status = MRenderUtil::sampleShadingNetwork(
+        texturePlug, numVertices, false, false, cameraMatrix, nullptr,
+        &m_vertexUs, &m_vertexVs, nullptr, nullptr, nullptr, nullptr, nullptr,
+        colors, transparencies);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    m_textureAmounts.resize(numVertices);
+    for (unsigned int ii = 0; ii < numVertices; ++ii) {
+        const MFloatVector &color = colors[ii];
+        m_textureAmounts[ii] =
+            0.3f * color.x + 0.59f * color.y + 0.11f * color.z;
+    }
+
+    m_texturePlug  = texturePlug;
+    m_textureDirty = false;
+
+    return MS::kSuccess;
+}
+
+const std::vector<int> &GeometryCache::triangles(MFnMesh &fnMesh) {
+    if (m_trianglesValid) {
+        return m_triangles;
+    }
+
+    MIntArray triangleCounts, triangleVertices;
+    fnMesh.getTriangles(triangleCounts, triangleVertices);
+    m_triangles.resize(triangleVertices.length());
+    for (unsigned int ii = 0; ii < triangleVertices.length(); ++ii) {
+        m_triangles[ii] = triangleVertices[ii];
+    }
+    m_trianglesValid = true;
+
+    return m_triangles;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <maya/MFloatArray.h>
+#include <maya/MFloatMatrix.h>
+#include <maya/MFloatVectorArray.h>
+#include <maya/MFnMesh.h>
+#include <maya/MIntArray.h>
+#include <maya/MRenderUtil.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+
+#include "VertexUVs.h"
+
+/**
+ * Per-geometry data the bulge deformer keeps between evaluations so that it
+ * only redoes work when the input mesh actually changed.
+ *
+ * Normals are keyed on a hash of the mesh topology and a fingerprint of its
+ * points. When the topology is unchanged and only a handful of points moved,
+ * only the normals of the moved vertices and their one-ring neighbours are
+ * recomputed. Smoothed normals are cached on top of those and only redone
+ * when the normals or the number of smoothing iterations change.
+ *
+ * Texture driven bulge amounts are sampled for every vertex at once and kept
+ * until the texture is dirtied or the UVs change.
+ */
+class GeometryCache {
+  public:
+    GeometryCache()
+        : m_topologyHash(0), m_pointsHash(0), m_normalsVersion(0),
+          m_smoothed(nullptr), m_smoothedVersion(0), m_smoothIterations(0),
+          m_uvTopologyHash(0), m_numUVs(0), m_uvsDirty(true),
+          m_textureDirty(true), m_trianglesValid(false), m_valid(false){};
+
+    /**
+     * Bring the cached normals up to date with the given mesh.
+     */
+    MStatus updateNormals(MFnMesh &fnMesh);
+
+    const MFloatVectorArray &normals() const { return m_normals; }
+
+    /**
+     * The normals after the given number of Laplacian smoothing iterations,
+     * each of which moves every normal halfway towards the average of its
+     * neighbours'.
+     */
+    const MFloatVectorArray &smoothedNormals(unsigned int iterations);
+
+    /**
+     * Bring the per-vertex texture samples up to date. texturePlug is the
+     * name of the (2D) texture output plug to sample, each vertex is sampled
+     * at its UV and the luminance of the result is used as its amount.
+     *
+     * The UVs are only read again after setUVsDirty or when the topology or
+     * the number of UVs changes, so updateNormals must have been called on
+     * the same mesh first. The texture is only sampled again if they moved.
+     */
+    MStatus updateTextureAmounts(MFnMesh &fnMesh, const MString &texturePlug);
+
+    /**
+     * Flag that the input geometry was dirtied, so its UVs may have moved.
+     */
+    void setUVsDirty() { m_uvsDirty = true; }
+
+    /**
+     * Flag that the connected texture changed and needs sampling again.
+     */
+    void setTextureDirty() { m_textureDirty = true; }
+
+    const std::vector<float> &textureAmounts() const {
+        return m_textureAmounts;
+    }
+
+    /**
+     * Vertex indices of the mesh's triangulation, three per triangle. Only
+     * triangulated again when the topology changes.
+     */
+    const std::vector<int> &triangles(MFnMesh &fnMesh);
+
+    /**
+     * Vertices sharing a face with each vertex, in compressed sparse row
+     * form: the neighbours of vertex i are
+     * adjacency()[adjacencyOffsets()[i]] up to
+     * adjacency()[adjacencyOffsets()[i + 1]].
+     */
+    const std::vector<unsigned int> &adjacencyOffsets() const {
+        return m_adjacencyOffsets;
+    }
+    const std::vector<unsigned int> &adjacency() const { return m_adjacency; }
+
+  private:
+    /**
+     * Rebuild everything that depends only on the mesh connectivity.
+     */
+    void buildAdjacency(unsigned int numVertices, const MIntArray &counts,
+                        const MIntArray &connects);
+    MStatus updateAllNormals(MFnMesh &fnMesh, const float *rawPoints);
+    MStatus updateMovedNormals(MFnMesh &fnMesh, const float *rawPoints,
+                               const std::vector<unsigned int> &moved);
+
+    // Topology
+    uint64_t m_topologyHash;
+    std::vector<unsigned int> m_adjacencyOffsets;
+    std::vector<unsigned int> m_adjacency;
+
+    // Points the cached normals were computed from
+    uint64_t m_pointsHash;
+    std::vector<float> m_points;
+
+    MFloatVectorArray m_normals;
+    // Bumped whenever m_normals changes
+    unsigned int m_normalsVersion;
+
+    // Smoothing alternates between the two buffers, m_smoothed points at
+    // whichever holds the result
+    MFloatVectorArray m_smoothBuffers[2];
+    const MFloatVectorArray *m_smoothed;
+    unsigned int m_smoothedVersion;
+    unsigned int m_smoothIterations;
+
+    // Texture samples, keyed on the UVs they were read with and the sampled
+    // plug
+    uint64_t m_uvTopologyHash;
+    int m_numUVs;
+    bool m_uvsDirty;
+    VertexUVs m_vertexUVs;
+    MFloatArray m_vertexUs;
+    MFloatArray m_vertexVs;
+    MString m_texturePlug;
+    std::vector<float> m_textureAmounts;
+    bool m_textureDirty;
+
+    std::vector<int> m_triangles;
+    bool m_trianglesValid;
+
+    bool m_valid;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <maya/MGlobal.h>
+#include <maya/MString.h>
+#include <maya/MTimer.h>
+
+/**
+ * Print how long the enclosing scope took to the script editor, and the
+ * throughput in points per second when given the number of points processed.
+ *
+ * Only active when the plugin is configured with -DENABLE_TIMING=ON, so that
+ * the normal build pays nothing for it.
+ */
+#ifdef ENABLE_TIMING
+class ScopedTimer {
+  public:
+    ScopedTimer(const MString &label, unsigned int numPoints = 0)
+        : m_label(label), m_numPoints(numPoints) {
+        m_timer.beginTimer();
+    }
+    ~ScopedTimer() {
+        m_timer.endTimer();
+        MString message(m_label);
+        message += ": ";
+        message += m_timer.elapsedTime() * 1000.0;
+        message += " ms";
+        if (m_numPoints > 0 && m_timer.elapsedTime() > 0.0) {
+            message += " (";
+            message += m_numPoints / m_timer.elapsedTime();
+            message += " points/s)";
+        }
+        MGlobal::displayInfo(message);
+    }
+
+  private:
+    MString m_label;
+    unsigned int m_numPoints;
+    MTimer m_timer;
+};
+#define TIME_SCOPE(...) ScopedTimer scopedTimer(__VA_ARGS__)
+#else
+#define TIME_SCOPE(...)
+#endif
@@ -0,0 +1,64 @@
+#include <cstddef>
+
+#include "VertexUVs.h"
+
+// 64-bit FNV-1a over 32-bit words
+static const uint64_t kHashOffset = 14695981039346656037ULL;
+static const uint64_t kHashPrime  = 1099511628211ULL;
+
+static uint64_t hashWords(uint64_t hash, const void *data, size_t numWords) {
+    const uint32_t *words = static_cast<const uint32_t *>(data);
+    for (size_t ii = 0; ii < numWords; ++ii) {
+        hash = (hash ^ words[ii]) * kHashPrime;
+    }
+    return hash;
+}
+
+bool VertexUVs::update(unsigned int numVertices, const float *us,
+                       const float *vs, unsigned int numUVs,
+                       const int *counts, const int *connects,
+                       unsigned int numFaces, const int *uvCounts,
+                       const int *uvIds) {
+    // The UV ids only mean something alongside the faces they belong to, so
+    // the faces are hashed too
+    unsigned int numCorners = 0, numUVCorners = 0;
+    for (unsigned int ff = 0; ff < numFaces; ++ff) {
+        numCorners += counts[ff];
+        numUVCorners += uvCounts[ff];
+    }
+    uint64_t hash = hashWords(kHashOffset, &numVertices, 1);
+    hash          = hashWords(hash, &numUVs, 1);
+    hash          = hashWords(hash, us, numUVs);
+    hash          = hashWords(hash, vs, numUVs);
+    hash          = hashWords(hash, &numFaces, 1);
+    hash          = hashWords(hash, counts, numFaces);
+    hash          = hashWords(hash, connects, numCorners);
+    hash          = hashWords(hash, uvCounts, numFaces);
+    hash          = hashWords(hash, uvIds, numUVCorners);
+    if (m_valid && hash == m_hash) {
+        return false;
+    }
+
+    std::vector<bool> assigned(numVertices, false);
+    m_us.assign(numVertices, 0.0f);
+    m_vs.assign(numVertices, 0.0f);
+    unsigned int corner = 0, uvCorner = 0;
+    for (unsigned int ff = 0; ff < numFaces; ++ff) {
+        // Faces without UVs have no entries in uvIds
+        bool hasUVs = uvCounts[ff] == counts[ff];
+        for (int jj = 0; jj < counts[ff]; ++jj, ++corner) {
+            int vv = connects[corner];
+            if (hasUVs && !assigned[vv]) {
+                m_us[vv]     = us[uvIds[uvCorner + jj]];
+                m_vs[vv]     = vs[uvIds[uvCorner + jj]];
+                assigned[vv] = true;
+            }
+        }
+        uvCorner += uvCounts[ff];
+    }
+
+    m_hash  = hash;
+    m_valid = true;
+
+    return true;
+}
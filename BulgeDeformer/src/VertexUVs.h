@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * The UV each vertex of a mesh samples textures at: the UV of the first face
+ * corner the vertex is used by, or the origin for vertices without UVs.
+ *
+ * The mesh's UVs and UV assignments are hashed, so handing the same ones
+ * over again costs one pass over them and leaves the per-vertex UVs alone.
+ * UVs that moved (or were unfolded or re-projected) without the number of
+ * UVs changing still hash differently.
+ */
+class VertexUVs {
+  public:
+    VertexUVs() : m_hash(0), m_valid(false){};
+
+    /**
+     * Bring the per-vertex UVs up to date with a mesh's UVs (numUVs each of
+     * us and vs), the vertex counts and indices of its faces (numFaces
+     * counts) and the UV count and UV indices of each face, as returned by
+     * MFnMesh::getUVs, getVertices and getAssignedUVs. Faces without UVs
+     * have a UV count of 0. Returns whether the per-vertex UVs changed.
+     */
+    bool update(unsigned int numVertices, const float *us, const float *vs,
+                unsigned int numUVs, const int *counts, const int *connects,
+                unsigned int numFaces, const int *uvCounts, const int *uvIds);
+
+    const std::vector<float> &us() const { return m_us; }
+    const std::vector<float> &vs() const { return m_vs; }
+
+  private:
+    uint64_t m_hash;
+    bool m_valid;
+    std::vector<float> m_us;
+    std::vector<float> m_vs;
+};
@@ -0,0 +1,96 @@
+#include <cmath>
+
+#include "ParallelFor.h"
+#include "VolumeSolver.h"
+
+// Number of triangles summed per block. Fixed so that the blocks, and so the
+// order the partial sums are added in, don't depend on the number of threads.
+static const unsigned int kTriangleBlockSize = 8192;
+static const unsigned int kMaxIterations     = 4;
+// Stop once within this fraction of the target volume
+static const double kTolerance = 1e-6;
+
+namespace {
+
+struct VolumeSums {
+    double volume;
+    double derivative;
+};
+
+// Signed volume of the mesh displaced by t, and its derivative
+VolumeSums sumVolume(const float *points, const float *directions,
+                     const std::vector<int> &triangles, double t) {
+    unsigned int numTriangles = triangles.size() / 3;
+    unsigned int numBlocks =
+        (numTriangles + kTriangleBlockSize - 1) / kTriangleBlockSize;
+    std::vector<VolumeSums> partials(numBlocks);
+
+    parallelFor(numBlocks, 1, [&](unsigned int beginBlock,
+                                  unsigned int endBlock) {
+        for (unsigned int block = beginBlock; block < endBlock; ++block) {
+            unsigned int begin = block * kTriangleBlockSize;
+            unsigned int end =
+                std::min(begin + kTriangleBlockSize, numTriangles);
+
+            double volume = 0.0, derivative = 0.0;
+            for (unsigned int tri = begin; tri < end; ++tri) {
+                double p[3][3], d[3][3];
+                for (int corner = 0; corner < 3; ++corner) {
+                    int vv = triangles[tri * 3 + corner];
+                    for (int axis = 0; axis < 3; ++axis) {
+                        d[corner][axis] = directions[vv * 3 + axis];
+                        p[corner][axis] =
+                            points[vv * 3 + axis] + d[corner][axis] * t;
+                    }
+                }
+
+                // V = a . (b x c) / 6, and dV/dt sums each corner's
+                // direction dotted with the cross product of the other two
+                double bc[3] = {p[1][1] * p[2][2] - p[1][2] * p[2][1],
+                                p[1][2] * p[2][0] - p[1][0] * p[2][2],
+                                p[1][0] * p[2][1] - p[1][1] * p[2][0]};
+                double ca[3] = {p[2][1] * p[0][2] - p[2][2] * p[0][1],
+                                p[2][2] * p[0][0] - p[2][0] * p[0][2],
+                                p[2][0] * p[0][1] - p[2][1] * p[0][0]};
+                double ab[3] = {p[0][1] * p[1][2] - p[0][2] * p[1][1],
+                                p[0][2] * p[1][0] - p[0][0] * p[1][2],
+                                p[0][0] * p[1][1] - p[0][1] * p[1][0]};
+                for (int axis = 0; axis < 3; ++axis) {
+                    volume += p[0][axis] * bc[axis];
+                    derivative += d[0][axis] * bc[axis] +
+                                  d[1][axis] * ca[axis] +
+                                  d[2][axis] * ab[axis];
+                }
+            }
+
+            partials[block].volume     = volume / 6.0;
+            partials[block].derivative = derivative / 6.0;
+        }
+    });
+
+    VolumeSums sums = {0.0, 0.0};
+    for (unsigned int block = 0; block < numBlocks; ++block) {
+        sums.volume += partials[block].volume;
+        sums.derivative += partials[block].derivative;
+    }
+    return sums;
+}
+
+} // namespace
+
+float solveVolumeAmount(const float *points, const float *directions,
+                        const std::vector<int> &triangles,
+                        double targetVolume) {
+    double t = 0.0;
+    for (unsigned int iteration = 0; iteration < kMaxIterations; ++iteration) {
+        VolumeSums sums = sumVolume(points, directions, triangles, t);
+        double error    = sums.volume - targetVolume;
+        if (std::fabs(error) <= kTolerance * std::fabs(targetVolume) ||
+            sums.derivative == 0.0) {
+            break;
+        }
+        t -= error / sums.derivative;
+    }
+
+    return (float)t;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * Find the amount t that gives a closed triangle mesh the target signed
+ * volume once every vertex i is moved from points[i] to
+ * points[i] + directions[i] * t.
+ *
+ * points and directions hold three floats per vertex, triangles holds three
+ * vertex indices per triangle. Solved with a few Newton iterations, each of
+ * which is a single parallel pass over the triangles accumulating both the
+ * volume and its derivative with respect to t. Returns 0 if the volume can't
+ * be changed by moving along the directions.
+ */
+float solveVolumeAmount(const float *points, const float *directions,
+                        const std::vector<int> &triangles,
+                        double targetVolume);
@@ -0,0 +1,76 @@
+#include <algorithm>
+
+#include <maya/MArrayDataHandle.h>
+
+#include "WeightCache.h"
+
+MStatus WeightCache::update(MDataBlock &data, unsigned int geomIndex,
+                            const std::vector<int> &indices) {
+    MStatus status;
+
+    if (!m_dirty && indices == m_indices) {
+        return MS::kSuccess;
+    }
+
+    // Weights that were never painted default to 1
+    int maxIndex = indices.empty()
+                       ? -1
+                       : *std::max_element(indices.begin(), indices.end());
+    std::vector<float> vertexWeights(maxIndex + 1, 1.0f);
+
+    // Only the painted weights are stored in the sparse weights array, walk
+    // that directly instead of looking up every vertex
+    MArrayDataHandle hWeightList =
+        data.inputArrayValue(MPxDeformerNode::weightList, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    if (hWeightList.jumpToElement(geomIndex)) {
+        MArrayDataHandle hWeights =
+            hWeightList.inputValue(&status).child(MPxDeformerNode::weights);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        unsigned int numWeights = hWeights.elementCount();
+        for (unsigned int ii = 0; ii < numWeights; ++ii, hWeights.next()) {
+            unsigned int index = hWeights.elementIndex();
+            if ((int)index <= maxIndex) {
+                vertexWeights[index] = hWeights.inputValue().asFloat();
+            }
+        }
+    }
+
+    unsigned int numPoints = indices.size();
+    m_weights.resize(numPoints);
+    m_activePoints.clear();
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        m_weights[ii] = vertexWeights[indices[ii]];
+        if (m_weights[ii] != 0.0f) {
+            m_activePoints.push_back(ii);
+        }
+    }
+
+    m_indices = indices;
+    m_dirty   = false;
+
+    return MS::kSuccess;
+}
+
+bool WeightCache::isWeightPlug(const MPlug &plug, int &geomIndex) {
+    geomIndex = -1;
+
+    // Walk up from the plug until we reach the top level attribute
+    MPlug current(plug);
+    while (true) {
+        if (current.attribute() == MPxDeformerNode::weightList) {
+            if (current.isElement()) {
+                geomIndex = current.logicalIndex();
+            }
+            return true;
+        }
+
+        if (current.isElement()) {
+            current = current.array();
+        } else if (current.isChild()) {
+            current = current.parent();
+        } else {
+            return false;
+        }
+    }
+}
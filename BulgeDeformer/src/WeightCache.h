@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <maya/MDataBlock.h>
+#include <maya/MPlug.h>
+#include <maya/MStatus.h>
+
+#include <maya/MPxDeformerNode.h>
+
+/**
+ * Painted deformer weights for one input geometry, read out of the weightList
+ * once and kept until the weightList is dirtied, rather than going through
+ * MPxDeformerNode::weightValue for every point on every evaluation.
+ *
+ * Weights are stored densely in the order the geometry iterator visits the
+ * points, alongside the (ascending) positions of the points whose weight is
+ * non-zero. When the deformer covers the whole mesh these positions are the
+ * vertex indices.
+ */
+class WeightCache {
+  public:
+    WeightCache() : m_dirty(true){};
+
+    /**
+     * Re-read the weights if they were dirtied or the points the deformer
+     * affects changed. indices holds the vertex index of each point in
+     * iteration order.
+     */
+    MStatus update(MDataBlock &data, unsigned int geomIndex,
+                   const std::vector<int> &indices);
+
+    void setDirty() { m_dirty = true; }
+
+    const std::vector<float> &weights() const { return m_weights; }
+    const std::vector<unsigned int> &activePoints() const {
+        return m_activePoints;
+    }
+
+    /**
+     * Whether plug is the weightList attribute or any plug below it. If it
+     * belongs to a single weightList element, geomIndex is set to that
+     * element's index, otherwise it is set to -1.
+     */
+    static bool isWeightPlug(const MPlug &plug, int &geomIndex);
+
+  private:
+    bool m_dirty;
+    std::vector<int> m_indices;
+    std::vector<float> m_weights;
+    std::vector<unsigned int> m_activePoints;
+};
@@ -0,0 +1,180 @@
+// Checks every bulge kernel the CPU supports against the scalar kernel, over
+// odd and even lengths so each vector width's tail handling is covered, and
+// from unaligned start offsets. Returns non-zero if any kernel disagrees or
+// writes past the end of its points.
+//
+// Then times each kernel over a few million points and prints its throughput
+// in points per second and its speedup over the scalar kernel. The timings
+// are only reported, they never fail the test.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../src/BulgeKernel.h"
+
+namespace {
+
+const unsigned int kMaxKernels = 8;
+const unsigned int kMaxOffset  = 4;
+const unsigned int kGuard      = 16;
+const float kSentinel          = 12345.0f;
+// Points and passes over them timed per kernel
+const unsigned int kBenchmarkPoints = 4 * 1024 * 1024;
+const unsigned int kBenchmarkPasses = 20;
+
+struct Streams {
+    std::vector<float> x, y, z, nx, ny, nz, w;
+
+    explicit Streams(unsigned int size)
+        : x(size), y(size), z(size), nx(size), ny(size), nz(size), w(size) {}
+};
+
+float randomFloat(float low, float high) {
+    return low + (high - low) * (float(std::rand()) / float(RAND_MAX));
+}
+
+bool closeEnough(float a, float b) {
+    // The FMA kernels round once where the scalar kernel rounds twice
+    float tolerance = 1e-5f * std::max(1.0f, std::fabs(b));
+    return std::fabs(a - b) <= tolerance;
+}
+
+bool checkKernel(BulgeKernel kernel, const char *name, unsigned int count,
+                 unsigned int offset) {
+    unsigned int size = offset + count + kGuard;
+    Streams input(size);
+    for (unsigned int ii = 0; ii < size; ++ii) {
+        input.x[ii]  = randomFloat(-100.0f, 100.0f);
+        input.y[ii]  = randomFloat(-100.0f, 100.0f);
+        input.z[ii]  = randomFloat(-100.0f, 100.0f);
+        input.nx[ii] = randomFloat(-1.0f, 1.0f);
+        input.ny[ii] = randomFloat(-1.0f, 1.0f);
+        input.nz[ii] = randomFloat(-1.0f, 1.0f);
+        input.w[ii]  = randomFloat(0.0f, 1.0f);
+    }
+    for (unsigned int ii = offset + count; ii < size; ++ii) {
+        input.x[ii] = input.y[ii] = input.z[ii] = kSentinel;
+    }
+    float scale = randomFloat(-2.0f, 2.0f);
+
+    Streams expected = input;
+    Streams actual   = input;
+    bulgeKernelScalar(&expected.x[offset], &expected.y[offset],
+                      &expected.z[offset], &input.nx[offset],
+                      &input.ny[offset], &input.nz[offset], &input.w[offset],
+                      scale, count);
+    kernel(&actual.x[offset], &actual.y[offset], &actual.z[offset],
+           &input.nx[offset], &input.ny[offset], &input.nz[offset],
+           &input.w[offset], scale, count);
+
+    for (unsigned int ii = 0; ii < size; ++ii) {
+        bool inRange = ii >= offset && ii < offset + count;
+        if (!inRange) {
+            if (actual.x[ii] != input.x[ii] || actual.y[ii] != input.y[ii] ||
+                actual.z[ii] != input.z[ii]) {
+                std::printf("%s: count %u offset %u wrote outside the points "
+                            "at %u\n",
+                            name, count, offset, ii);
+                return false;
+            }
+            continue;
+        }
+        if (!closeEnough(actual.x[ii], expected.x[ii]) ||
+            !closeEnough(actual.y[ii], expected.y[ii]) ||
+            !closeEnough(actual.z[ii], expected.z[ii])) {
+            std::printf("%s: count %u offset %u differs at %u: "
+                        "(%g, %g, %g) expected (%g, %g, %g)\n",
+                        name, count, offset, ii, actual.x[ii], actual.y[ii],
+                        actual.z[ii], expected.x[ii], expected.y[ii],
+                        expected.z[ii]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Points per second the kernel manages over kBenchmarkPoints points, best of
+// kBenchmarkPasses passes so a busy machine skews the result less
+double benchmarkKernel(BulgeKernel kernel) {
+    Streams streams(kBenchmarkPoints);
+    for (unsigned int ii = 0; ii < kBenchmarkPoints; ++ii) {
+        streams.x[ii]  = randomFloat(-100.0f, 100.0f);
+        streams.y[ii]  = randomFloat(-100.0f, 100.0f);
+        streams.z[ii]  = randomFloat(-100.0f, 100.0f);
+        streams.nx[ii] = randomFloat(-1.0f, 1.0f);
+        streams.ny[ii] = randomFloat(-1.0f, 1.0f);
+        streams.nz[ii] = randomFloat(-1.0f, 1.0f);
+        streams.w[ii]  = randomFloat(0.0f, 1.0f);
+    }
+
+    double bestSeconds = 0.0;
+    for (unsigned int pass = 0; pass < kBenchmarkPasses; ++pass) {
+        // Alternate the direction so the points stay where they started
+        float scale = pass % 2 == 0 ? 0.01f : -0.01f;
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+        kernel(&streams.x[0], &streams.y[0], &streams.z[0], &streams.nx[0],
+               &streams.ny[0], &streams.nz[0], &streams.w[0], scale,
+               kBenchmarkPoints);
+        double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+        if (pass == 0 || seconds < bestSeconds) {
+            bestSeconds = seconds;
+        }
+    }
+    return bestSeconds > 0.0 ? kBenchmarkPoints / bestSeconds : 0.0;
+}
+
+} // namespace
+
+int main() {
+    std::srand(1);
+
+    BulgeKernel kernels[kMaxKernels];
+    const char *names[kMaxKernels];
+    unsigned int numKernels =
+        supportedBulgeKernels(kernels, names, kMaxKernels);
+
+    // Every length up to a few of the widest vectors, so each kernel sees
+    // every tail length, then some larger odd and even ones
+    std::vector<unsigned int> counts;
+    for (unsigned int count = 0; count <= 70; ++count) {
+        counts.push_back(count);
+    }
+    counts.push_back(255);
+    counts.push_back(256);
+    counts.push_back(257);
+    counts.push_back(1023);
+    counts.push_back(1024);
+
+    int failures = 0;
+    for (unsigned int kk = 0; kk < numKernels && kk < kMaxKernels; ++kk) {
+        bool passed = true;
+        for (size_t cc = 0; cc < counts.size(); ++cc) {
+            for (unsigned int offset = 0; offset < kMaxOffset; ++offset) {
+                passed &= checkKernel(kernels[kk], names[kk], counts[cc],
+                                      offset);
+            }
+        }
+        std::printf("%s: %s\n", names[kk], passed ? "passed" : "FAILED");
+        failures += passed ? 0 : 1;
+    }
+
+    // The scalar kernel is always first, the others are compared to it
+    double scalarRate = 0.0;
+    for (unsigned int kk = 0; kk < numKernels && kk < kMaxKernels; ++kk) {
+        double rate = benchmarkKernel(kernels[kk]);
+        if (kk == 0) {
+            scalarRate = rate;
+        }
+        std::printf("%s: %.0f million points/s, %.2fx scalar\n", names[kk],
+                    rate / 1e6, scalarRate > 0.0 ? rate / scalarRate : 0.0);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
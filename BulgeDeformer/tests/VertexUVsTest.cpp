@@ -0,0 +1,79 @@
+// Checks that VertexUVs notices UVs that move without the number of UVs or
+// the topology changing, and leaves the per-vertex UVs alone when nothing
+// changed. Returns non-zero on failure.
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "../src/VertexUVs.h"
+
+namespace {
+
+// Two quads sharing an edge:
+//
+//   3---4---5
+//   |   |   |
+//   0---1---2
+struct Mesh {
+    unsigned int numVertices;
+    std::vector<float> us, vs;
+    std::vector<int> counts, connects, uvCounts, uvIds;
+
+    Mesh() : numVertices(6) {
+        const float gridUs[] = {0.0f, 0.5f, 1.0f, 0.0f, 0.5f, 1.0f};
+        const float gridVs[] = {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+        const int faces[]    = {0, 1, 4, 3, 1, 2, 5, 4};
+        us.assign(gridUs, gridUs + 6);
+        vs.assign(gridVs, gridVs + 6);
+        counts.assign(2, 4);
+        connects.assign(faces, faces + 8);
+        uvCounts.assign(2, 4);
+        uvIds.assign(faces, faces + 8);
+    }
+
+    bool update(VertexUVs &vertexUVs) const {
+        return vertexUVs.update(numVertices, &us[0], &vs[0], us.size(),
+                                &counts[0], &connects[0], counts.size(),
+                                &uvCounts[0], &uvIds[0]);
+    }
+};
+
+int s_failures = 0;
+
+void check(bool passed, const char *what) {
+    std::printf("%s: %s\n", what, passed ? "passed" : "FAILED");
+    s_failures += passed ? 0 : 1;
+}
+
+} // namespace
+
+int main() {
+    Mesh mesh;
+    VertexUVs vertexUVs;
+
+    check(mesh.update(vertexUVs), "first update reads the UVs");
+    check(vertexUVs.us()[4] == 0.5f && vertexUVs.vs()[4] == 1.0f,
+          "vertex takes its corner's UV");
+    check(!mesh.update(vertexUVs), "unchanged UVs are kept");
+
+    // Move one UV, the count and topology stay the same
+    mesh.us[4] = 0.75f;
+    check(mesh.update(vertexUVs), "moved UV is noticed");
+    check(vertexUVs.us()[4] == 0.75f, "moved UV is read");
+    check(!mesh.update(vertexUVs), "moved UVs are then kept");
+
+    // Re-project: same UVs, assigned to the corners the other way round
+    std::swap(mesh.uvIds[0], mesh.uvIds[1]);
+    check(mesh.update(vertexUVs), "reassigned UVs are noticed");
+    check(vertexUVs.us()[0] == 0.5f, "reassigned UV is read");
+
+    // Faces without UVs leave their vertices at the origin
+    mesh.uvCounts[1] = 0;
+    mesh.uvIds.resize(4);
+    check(mesh.update(vertexUVs), "removed face UVs are noticed");
+    check(vertexUVs.us()[2] == 0.0f && vertexUVs.vs()[5] == 0.0f,
+          "vertices without UVs sample the origin");
+
+    return s_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "KdTree.h"
+
+// Ranges this small are searched point by point rather than split further
+static const unsigned int kLeafSize = 8;
+
+namespace {
+
+// A point being sorted into tree order, kept together with its index so the
+// partitioning moves contiguous data around
+struct BuildPoint {
+    double p[3];
+    int index;
+};
+
+// Arrange points[begin, end) into tree order
+void buildRange(std::vector<BuildPoint> &points,
+                std::vector<unsigned char> &axes, unsigned int begin,
+                unsigned int end) {
+    if (end - begin <= kLeafSize) {
+        return;
+    }
+
+    // Split along the axis the points are most spread out on
+    double minimum[3], maximum[3];
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        minimum[axis] = std::numeric_limits<double>::max();
+        maximum[axis] = -std::numeric_limits<double>::max();
+    }
+    for (unsigned int ii = begin; ii < end; ++ii) {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            minimum[axis] = std::min(minimum[axis], points[ii].p[axis]);
+            maximum[axis] = std::max(maximum[axis], points[ii].p[axis]);
+        }
+    }
+    unsigned int axis = 0;
+    for (unsigned int aa = 1; aa < 3; ++aa) {
+        if (maximum[aa] - minimum[aa] > maximum[axis] - minimum[axis]) {
+            axis = aa;
+        }
+    }
+
+    unsigned int middle = begin + (end - begin) / 2;
+    std::nth_element(points.begin() + begin, points.begin() + middle,
+                     points.begin() + end,
+                     [axis](const BuildPoint &a, const BuildPoint &b) {
+                         return a.p[axis] < b.p[axis];
+                     });
+    axes[middle] = (unsigned char)axis;
+
+    buildRange(points, axes, begin, middle);
+    buildRange(points, axes, middle + 1, end);
+}
+
+} // namespace
+
+void KdTree::build(const MPointArray &points) {
+    unsigned int numPoints = points.length();
+    std::vector<BuildPoint> buildPoints(numPoints);
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        buildPoints[ii].p[0]  = points[ii].x;
+        buildPoints[ii].p[1]  = points[ii].y;
+        buildPoints[ii].p[2]  = points[ii].z;
+        buildPoints[ii].index = ii;
+    }
+
+    m_axes.assign(numPoints, 0);
+    buildRange(buildPoints, m_axes, 0, numPoints);
+
+    m_points.resize(numPoints * 3);
+    m_indices.resize(numPoints);
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        m_points[ii * 3]     = buildPoints[ii].p[0];
+        m_points[ii * 3 + 1] = buildPoints[ii].p[1];
+        m_points[ii * 3 + 2] = buildPoints[ii].p[2];
+        m_indices[ii]        = buildPoints[ii].index;
+    }
+}
+
+int KdTree::nearest(const MPoint &point, double &distance) const {
+    int bestIndex         = -1;
+    double bestDistanceSq = std::numeric_limits<double>::max();
+    double query[3]       = {point.x, point.y, point.z};
+    nearest(0, size(), query, bestIndex, bestDistanceSq);
+
+    distance = bestIndex < 0 ? 0.0 : std::sqrt(bestDistanceSq);
+    return bestIndex;
+}
+
+void KdTree::nearest(unsigned int begin, unsigned int end, const double *point,
+                     int &bestIndex, double &bestDistanceSq) const {
+    if (end - begin <= kLeafSize) {
+        for (unsigned int ii = begin; ii < end; ++ii) {
+            testPoint(ii, point, bestIndex, bestDistanceSq);
+        }
+        return;
+    }
+
+    unsigned int middle = begin + (end - begin) / 2;
+    testPoint(middle, point, bestIndex, bestDistanceSq);
+
+    // Search the side the point is on first, then the other side only if it
+    // could hold something closer. Equally close points are still searched
+    // so that ties always go the same way.
+    unsigned int axis = m_axes[middle];
+    double offset     = point[axis] - m_points[middle * 3 + axis];
+    if (offset < 0.0) {
+        nearest(begin, middle, point, bestIndex, bestDistanceSq);
+        if (offset * offset <= bestDistanceSq) {
+            nearest(middle + 1, end, point, bestIndex, bestDistanceSq);
+        }
+    } else {
+        nearest(middle + 1, end, point, bestIndex, bestDistanceSq);
+        if (offset * offset <= bestDistanceSq) {
+            nearest(begin, middle, point, bestIndex, bestDistanceSq);
+        }
+    }
+}
+
+void KdTree::testPoint(unsigned int position, const double *point,
+                       int &bestIndex, double &bestDistanceSq) const {
+    const double *candidate = &m_points[position * 3];
+    double dx               = candidate[0] - point[0];
+    double dy               = candidate[1] - point[1];
+    double dz               = candidate[2] - point[2];
+    double distanceSq       = dx * dx + dy * dy + dz * dz;
+    int index               = m_indices[position];
+    if (distanceSq < bestDistanceSq ||
+        (distanceSq == bestDistanceSq && index < bestIndex)) {
+        bestIndex      = index;
+        bestDistanceSq = distanceSq;
+    }
+}
+
+unsigned int KdTree::nearest(const MPoint &point, unsigned int k, int *indices,
+                             double *distances) const {
+    Neighbours neighbours = {k, 0, indices, distances};
+    double query[3]       = {point.x, point.y, point.z};
+    if (k > 0) {
+        nearest(0, size(), query, neighbours);
+    }
+
+    for (unsigned int ii = 0; ii < neighbours.count; ++ii) {
+        distances[ii] = std::sqrt(distances[ii]);
+    }
+    return neighbours.count;
+}
+
+void KdTree::nearest(unsigned int begin, unsigned int end, const double *point,
+                     Neighbours &neighbours) const {
+    if (end - begin <= kLeafSize) {
+        for (unsigned int ii = begin; ii < end; ++ii) {
+            const double *candidate = &m_points[ii * 3];
+            double dx               = candidate[0] - point[0];
+            double dy               = candidate[1] - point[1];
+            double dz               = candidate[2] - point[2];
+            neighbours.add(m_indices[ii], dx * dx + dy * dy + dz * dz);
+        }
+        return;
+    }
+
+    unsigned int middle     = begin + (end - begin) / 2;
+    const double *candidate = &m_points[middle * 3];
+    double dx               = candidate[0] - point[0];
+    double dy               = candidate[1] - point[1];
+    double dz               = candidate[2] - point[2];
+    neighbours.add(m_indices[middle], dx * dx + dy * dy + dz * dz);
+
+    unsigned int axis = m_axes[middle];
+    double offset     = point[axis] - candidate[axis];
+    if (offset < 0.0) {
+        nearest(begin, middle, point, neighbours);
+        if (offset * offset <= neighbours.worstDistanceSq()) {
+            nearest(middle + 1, end, point, neighbours);
+        }
+    } else {
+        nearest(middle + 1, end, point, neighbours);
+        if (offset * offset <= neighbours.worstDistanceSq()) {
+            nearest(begin, middle, point, neighbours);
+        }
+    }
+}
+
+double KdTree::Neighbours::worstDistanceSq() const {
+    return count < k ? std::numeric_limits<double>::max()
+                     : distancesSq[count - 1];
+}
+
+void KdTree::Neighbours::add(int index, double distanceSq) {
+    // Find where it goes, ties are ordered by index
+    unsigned int position = count;
+    while (position > 0 &&
+           (distanceSq < distancesSq[position - 1] ||
+            (distanceSq == distancesSq[position - 1] &&
+             index < indices[position - 1]))) {
+        --position;
+    }
+    if (position >= k) {
+        return;
+    }
+
+    unsigned int last = count < k ? count : k - 1;
+    for (unsigned int ii = last; ii > position; --ii) {
+        indices[ii]     = indices[ii - 1];
+        distancesSq[ii] = distancesSq[ii - 1];
+    }
+    indices[position]     = index;
+    distancesSq[position] = distanceSq;
+    if (count < k) {
+        ++count;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include <maya/MPoint.h>
+#include <maya/MPointArray.h>
+
+/**
+ * A kd-tree over a fixed set of points for nearest neighbour queries.
+ *
+ * The tree is implicit: the points are reordered so that each range's median
+ * (on the range's split axis) sits in the middle of the range, with the
+ * points on either side of it in the two halves. Only the point data, the
+ * original indices and one split axis per point are stored.
+ */
+class KdTree {
+  public:
+    KdTree(){};
+
+    /**
+     * Build the tree over the given points, replacing any previous tree.
+     */
+    void build(const MPointArray &points);
+
+    /**
+     * Index (into the array the tree was built from) of the point nearest to
+     * the given point, or -1 if the tree is empty. Ties go to the lowest
+     * index. distance is set to the distance between the two.
+     */
+    int nearest(const MPoint &point, double &distance) const;
+
+    /**
+     * Indices of the (up to) k points nearest to the given point, nearest
+     * first, with ties going to the lowest index. indices and distances must
+     * have room for k values. Returns how many were found, which is only less
+     * than k if the tree holds fewer points.
+     */
+    unsigned int nearest(const MPoint &point, unsigned int k, int *indices,
+                         double *distances) const;
+
+    unsigned int size() const { return (unsigned int)m_indices.size(); }
+
+    /**
+     * Bytes held by the tree.
+     */
+    size_t memoryUsage() const {
+        return m_points.capacity() * sizeof(double) +
+               m_indices.capacity() * sizeof(int) + m_axes.capacity();
+    }
+
+  private:
+    void nearest(unsigned int begin, unsigned int end, const double *point,
+                 int &bestIndex, double &bestDistanceSq) const;
+    void testPoint(unsigned int position, const double *point, int &bestIndex,
+                   double &bestDistanceSq) const;
+
+    // The k nearest points found so far, nearest first
+    struct Neighbours {
+        unsigned int k;
+        unsigned int count;
+        int *indices;
+        double *distancesSq;
+
+        // Largest distance still worth searching
+        double worstDistanceSq() const;
+        void add(int index, double distanceSq);
+    };
+    void nearest(unsigned int begin, unsigned int end, const double *point,
+                 Neighbours &neighbours) const;
+
+    // x, y, z of each point, in tree order
+    std::vector<double> m_points;
+    // Original index of each point, in tree order
+    std::vector<int> m_indices;
+    // Split axis of the range whose median is at each position
+    std::vector<unsigned char> m_axes;
+};
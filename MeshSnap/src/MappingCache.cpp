@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <utility>
+
+#include "MappingCache.h"
+
+MStatus MappingCache::update(const MObject &oMapData, unsigned int numPoints,
+                             const std::vector<int> &indices) {
+    MStatus status;
+
+    if (!needsIndices(numPoints)) {
+        return MS::kSuccess;
+    }
+    if (!m_dirty && numPoints == m_numPoints && indices == m_indices) {
+        m_pointsDirty = false;
+        return MS::kSuccess;
+    }
+
+    m_points.clear();
+    for (unsigned int corner = 0; corner < 3; ++corner) {
+        m_snapIndices[corner].clear();
+    }
+    for (unsigned int corner = 0; corner < 2; ++corner) {
+        m_weights[corner].clear();
+    }
+    m_rbfIndices.clear();
+    m_rbfWeights.clear();
+    m_offsets.clear();
+    m_surface      = false;
+    m_rbfK         = 0;
+    m_maxSnapIndex = -1;
+
+    if (!oMapData.isNull()) {
+        MFnPluginData fnMapData(oMapData, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        if (fnMapData.typeId() == SurfaceBindingData::id) {
+            m_surface = true;
+            updateSurfaceBinding(
+                *static_cast<const SurfaceBindingData *>(fnMapData.constData()),
+                numPoints, indices);
+        } else if (fnMapData.typeId() == RbfBindingData::id) {
+            updateRbfBinding(
+                *static_cast<const RbfBindingData *>(fnMapData.constData()),
+                numPoints, indices);
+        } else {
+            updateVertexMapping(
+                *static_cast<const VertexMappingData *>(fnMapData.constData()),
+                numPoints, indices);
+        }
+
+        for (unsigned int corner = 0; corner < 3; ++corner) {
+            const std::vector<unsigned int> &snapIndices =
+                m_snapIndices[corner];
+            for (size_t ii = 0; ii < snapIndices.size(); ++ii) {
+                m_maxSnapIndex =
+                    std::max(m_maxSnapIndex, (int)snapIndices[ii]);
+            }
+        }
+        for (size_t ii = 0; ii < m_rbfIndices.size(); ++ii) {
+            m_maxSnapIndex = std::max(m_maxSnapIndex, (int)m_rbfIndices[ii]);
+        }
+    }
+
+    m_numPoints   = numPoints;
+    m_indices     = indices;
+    m_dirty       = false;
+    m_pointsDirty = false;
+
+    return MS::kSuccess;
+}
+
+void MappingCache::updateVertexMapping(const VertexMappingData &mapData,
+                                       unsigned int numPoints,
+                                       const std::vector<int> &indices) {
+    const std::vector<unsigned int> &vertices    = mapData.vertices();
+    const std::vector<unsigned int> &snapIndices = mapData.snapIndices();
+
+    if (indices.empty()) {
+        // Positions are vertices, the mapped vertices are already the pairs
+        for (size_t ii = 0; ii < vertices.size(); ++ii) {
+            if (vertices[ii] >= numPoints) {
+                break;
+            }
+            m_points.push_back(vertices[ii]);
+            m_snapIndices[0].push_back(snapIndices[ii]);
+        }
+        return;
+    }
+
+    // Walk the affected vertices and the mapped vertices together in vertex
+    // order, then put the pairs back in iteration order
+    std::vector<std::pair<unsigned int, unsigned int>> byVertex;
+    byVertex.reserve(numPoints);
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        byVertex.push_back(std::make_pair(indices[ii], ii));
+    }
+    std::sort(byVertex.begin(), byVertex.end());
+
+    std::vector<std::pair<unsigned int, unsigned int>> pairs;
+    size_t mm = 0;
+    for (size_t ii = 0; ii < byVertex.size(); ++ii) {
+        while (mm < vertices.size() && vertices[mm] < byVertex[ii].first) {
+            ++mm;
+        }
+        if (mm == vertices.size()) {
+            break;
+        }
+        if (vertices[mm] == byVertex[ii].first) {
+            pairs.push_back(
+                std::make_pair(byVertex[ii].second, snapIndices[mm]));
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    for (size_t ii = 0; ii < pairs.size(); ++ii) {
+        m_points.push_back(pairs[ii].first);
+        m_snapIndices[0].push_back(pairs[ii].second);
+    }
+}
+
+void MappingCache::updateSurfaceBinding(const SurfaceBindingData &bindData,
+                                        unsigned int numPoints,
+                                        const std::vector<int> &indices) {
+    // Every base vertex is bound, so each point can look its binding up
+    // directly
+    unsigned int numBaseVertices = bindData.numBaseVertices();
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        unsigned int vertex = indices.empty() ? ii : indices[ii];
+        if (vertex >= numBaseVertices) {
+            continue;
+        }
+
+        m_points.push_back(ii);
+        for (unsigned int corner = 0; corner < 3; ++corner) {
+            m_snapIndices[corner].push_back(
+                bindData.triangleVertices(corner)[vertex]);
+        }
+        for (unsigned int corner = 0; corner < 2; ++corner) {
+            m_weights[corner].push_back(bindData.weights(corner)[vertex]);
+        }
+    }
+}
+
+void MappingCache::updateRbfBinding(const RbfBindingData &bindData,
+                                    unsigned int numPoints,
+                                    const std::vector<int> &indices) {
+    unsigned int numBaseVertices = bindData.numBaseVertices();
+    m_rbfK                       = bindData.k();
+    if (m_rbfK == 0) {
+        return;
+    }
+
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        unsigned int vertex = indices.empty() ? ii : indices[ii];
+        if (vertex >= numBaseVertices) {
+            continue;
+        }
+
+        m_points.push_back(ii);
+        const unsigned int *rowIndices = bindData.indices(vertex);
+        const float *rowWeights        = bindData.weights(vertex);
+        const float *offset            = bindData.offset(vertex);
+        m_rbfIndices.insert(m_rbfIndices.end(), rowIndices,
+                            rowIndices + m_rbfK);
+        m_rbfWeights.insert(m_rbfWeights.end(), rowWeights,
+                            rowWeights + m_rbfK);
+        m_offsets.insert(m_offsets.end(), offset, offset + 3);
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+
+#include <maya/MFnPluginData.h>
+#include <maya/MObject.h>
+#include <maya/MStatus.h>
+
+#include "RbfBindingData.h"
+#include "SurfaceBindingData.h"
+#include "VertexMappingData.h"
+
+/**
+ * The vertex mapping, surface or RBF binding of one input geometry, compacted
+ * down to the points that are actually bound to the snap mesh and kept until
+ * the mapping is dirtied.
+ *
+ * Bindings are stored as parallel arrays: the position of each bound point in
+ * iteration order (ascending) and what it is bound to, so that deforming only
+ * touches bound points. A vertex mapping binds each point to one snap vertex,
+ * a surface binding to the three snap vertices of a triangle and the weights
+ * of the first two, and an RBF binding to rbfK() snap vertices with a weight
+ * each plus an offset, held as fixed size rows.
+ */
+class MappingCache {
+  public:
+    MappingCache()
+        : m_dirty(true), m_pointsDirty(true), m_numPoints(0), m_surface(false),
+          m_rbfK(0), m_maxSnapIndex(-1){};
+
+    /**
+     * Whether update needs the vertex index of each point: the bindings were
+     * dirtied, or the points the deformer affects may have changed. While
+     * this is false there is no need to walk the geometry for them.
+     */
+    bool needsIndices(unsigned int numPoints) const {
+        return m_dirty || m_pointsDirty || numPoints != m_numPoints;
+    }
+
+    /**
+     * Rebuild the bindings from vertex mapping, surface or RBF binding data if
+     * they were dirtied or the points the deformer affects changed. indices
+     * holds the vertex index of each of the numPoints points in iteration
+     * order, or is empty when the points are the vertices in order. It is
+     * only looked at when needsIndices is true.
+     */
+    MStatus update(const MObject &oMapData, unsigned int numPoints,
+                   const std::vector<int> &indices);
+
+    void setDirty() { m_dirty = true; }
+    /**
+     * The input geometry or its membership were dirtied, so the points the
+     * deformer affects are checked against the cached ones on the next
+     * update.
+     */
+    void setPointsDirty() { m_pointsDirty = true; }
+
+    const std::vector<unsigned int> &points() const { return m_points; }
+    /**
+     * Whether the points are bound to triangles rather than single vertices.
+     */
+    bool isSurface() const { return m_surface; }
+    /**
+     * Snap vertex of each point, or for surface bindings the snap vertex at
+     * the given corner (0, 1 or 2) of each point's triangle.
+     */
+    const std::vector<unsigned int> &
+    snapIndices(unsigned int corner = 0) const {
+        return m_snapIndices[corner];
+    }
+    /**
+     * Weight of the first (0) or second (1) corner of each point's triangle.
+     */
+    const std::vector<float> &weights(unsigned int corner) const {
+        return m_weights[corner];
+    }
+    /**
+     * Number of snap vertices each point is bound to by an RBF binding, 0 if
+     * the points aren't bound that way.
+     */
+    unsigned int rbfK() const { return m_rbfK; }
+    /**
+     * Snap vertices and their weights for each point of an RBF binding, rbfK()
+     * per point.
+     */
+    const std::vector<unsigned int> &rbfIndices() const { return m_rbfIndices; }
+    const std::vector<float> &rbfWeights() const { return m_rbfWeights; }
+    /**
+     * Offset of each point of an RBF binding in the snap mesh's object space,
+     * x, y and z per point.
+     */
+    const std::vector<float> &offsets() const { return m_offsets; }
+    /**
+     * Highest snap vertex index bound to, -1 if nothing is bound.
+     */
+    int maxSnapIndex() const { return m_maxSnapIndex; }
+
+  private:
+    void updateVertexMapping(const VertexMappingData &mapData,
+                             unsigned int numPoints,
+                             const std::vector<int> &indices);
+    void updateSurfaceBinding(const SurfaceBindingData &bindData,
+                              unsigned int numPoints,
+                              const std::vector<int> &indices);
+    void updateRbfBinding(const RbfBindingData &bindData,
+                          unsigned int numPoints,
+                          const std::vector<int> &indices);
+
+    bool m_dirty;
+    bool m_pointsDirty;
+    unsigned int m_numPoints;
+    std::vector<int> m_indices;
+    bool m_surface;
+    std::vector<unsigned int> m_points;
+    std::vector<unsigned int> m_snapIndices[3];
+    std::vector<float> m_weights[2];
+    unsigned int m_rbfK;
+    std::vector<unsigned int> m_rbfIndices;
+    std::vector<float> m_rbfWeights;
+    std::vector<float> m_offsets;
+    int m_maxSnapIndex;
+};
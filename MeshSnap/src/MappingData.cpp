@@ -0,0 +1,54 @@
+#include <cstring>
+
+#include "MappingData.h"
+
+bool MappingData::hasArgs(const MArgList &args, unsigned int lastElement,
+                          unsigned int count, unsigned int argsPerEntry) {
+    if (lastElement > args.length()) {
+        return false;
+    }
+    unsigned int remaining = args.length() - lastElement;
+    return argsPerEntry == 0 || count <= remaining / argsPerEntry;
+}
+
+MStatus MappingData::readHashASCII(const MArgList &args,
+                                   unsigned int &lastElement) {
+    MStatus status;
+
+    // <high 32 bits> <low 32 bits>, each as a signed int so they survive
+    // being read back with asInt
+    m_snapTopologyHash = 0;
+    if (lastElement >= args.length()) {
+        return MS::kSuccess;
+    }
+    uint32_t high = (uint32_t)args.asInt(lastElement++, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    uint32_t low = (uint32_t)args.asInt(lastElement++, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    m_snapTopologyHash = ((uint64_t)high << 32) | low;
+
+    return MS::kSuccess;
+}
+
+MStatus MappingData::readHashBinary(const unsigned char *bytes, size_t size) {
+    m_snapTopologyHash = 0;
+    if (size == 0) {
+        return MS::kSuccess;
+    }
+    if (size != kHashBytes) {
+        return MS::kFailure;
+    }
+    std::memcpy(&m_snapTopologyHash, bytes, kHashBytes);
+
+    return MS::kSuccess;
+}
+
+void MappingData::writeHashASCII(std::ostream &out) const {
+    out << " " << (int32_t)(uint32_t)(m_snapTopologyHash >> 32) << " "
+        << (int32_t)(uint32_t)m_snapTopologyHash;
+}
+
+void MappingData::writeHashBinary(std::ostream &out) const {
+    out.write(reinterpret_cast<const char *>(&m_snapTopologyHash),
+              kHashBytes);
+}
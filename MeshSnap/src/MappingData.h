@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#include <maya/MArgList.h>
+#include <maya/MStatus.h>
+
+#include <maya/MPxData.h>
+
+/**
+ * What the meshSnap mapping types (vertex mapping, surface and RBF
+ * bindings) have in common: besides the mapping itself each remembers the
+ * topology of the snap mesh it was made for, so the node can tell whether a
+ * mapping still fits its meshes after the scene is closed and reopened.
+ *
+ * The hash is written after the mapping. It is optional when reading so
+ * that mappings saved without one still load, those have a hash of 0 and
+ * can only be checked against the number of base vertices.
+ */
+class MappingData : public MPxData {
+  public:
+    MappingData() : m_snapTopologyHash(0){};
+    virtual ~MappingData(){};
+
+    /**
+     * Number of vertices on the base mesh the mapping was made for.
+     */
+    virtual unsigned int numBaseVertices() const = 0;
+
+    /**
+     * topologyHash of the snap mesh the mapping was made for, 0 if unknown.
+     */
+    uint64_t snapTopologyHash() const { return m_snapTopologyHash; }
+    void setSnapTopologyHash(uint64_t hash) { m_snapTopologyHash = hash; }
+
+    /**
+     * Whether the mapping was made for a base mesh with numBaseVertices
+     * vertices and a snap mesh with the given topology hash. Mappings
+     * without a hash are only checked on the number of vertices.
+     */
+    bool fits(unsigned int numBaseVertices, uint64_t snapTopologyHash) const {
+        return numBaseVertices == this->numBaseVertices() &&
+               (m_snapTopologyHash == 0 ||
+                m_snapTopologyHash == snapTopologyHash);
+    }
+
+  protected:
+    // Size of the hash at the end of the binary form
+    static const unsigned int kHashBytes = sizeof(uint64_t);
+
+    /**
+     * Whether args holds at least count entries of argsPerEntry arguments
+     * each after lastElement. Checked before making room for a count read
+     * from a file, which may be corrupt or negative.
+     */
+    static bool hasArgs(const MArgList &args, unsigned int lastElement,
+                        unsigned int count, unsigned int argsPerEntry);
+
+    /**
+     * Read the hash from the arguments after the mapping, if there are any.
+     */
+    MStatus readHashASCII(const MArgList &args, unsigned int &lastElement);
+    /**
+     * Read the hash from the bytes left after the mapping, which must be
+     * either none or exactly kHashBytes.
+     */
+    MStatus readHashBinary(const unsigned char *bytes, size_t size);
+    void writeHashASCII(std::ostream &out) const;
+    void writeHashBinary(std::ostream &out) const;
+
+    uint64_t m_snapTopologyHash;
+};
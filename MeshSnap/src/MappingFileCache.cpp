@@ -0,0 +1,180 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappingFileCache.h"
+
+static const uint32_t kVersion = 1;
+
+namespace {
+
+// Reads straight out of a block of memory
+class MemoryBuffer : public std::streambuf {
+  public:
+    MemoryBuffer(const char *data, size_t size) {
+        char *begin = const_cast<char *>(data);
+        setg(begin, begin, begin + size);
+    }
+};
+
+// A whole file mapped read-only, unmapped when it goes out of scope
+class MappedFile {
+  public:
+    MappedFile(const MString &path) : m_data(nullptr), m_size(0) {
+#ifdef _WIN32
+        HANDLE file =
+            CreateFileA(path.asChar(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            HANDLE mapping =
+                CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr) {
+                m_data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+            m_size = m_data != nullptr ? (size_t)size.QuadPart : 0;
+        }
+        CloseHandle(file);
+#else
+        int file = ::open(path.asChar(), O_RDONLY);
+        if (file < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size > 0) {
+            void *data = mmap(nullptr, (size_t)info.st_size, PROT_READ,
+                              MAP_PRIVATE, file, 0);
+            if (data != MAP_FAILED) {
+                m_data = data;
+                m_size = (size_t)info.st_size;
+            }
+        }
+        ::close(file);
+#endif
+    }
+
+    ~MappedFile() {
+        if (m_data == nullptr) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap(m_data, m_size);
+#endif
+    }
+
+    const char *data() const { return static_cast<const char *>(m_data); }
+    size_t size() const { return m_size; }
+
+  private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    void *m_data;
+    size_t m_size;
+};
+
+} // namespace
+
+bool MappingFileCache::load(uint64_t key, const MTypeId &id,
+                            MPxData &data) const {
+    if (!isEnabled()) {
+        return false;
+    }
+
+    MappedFile file(path(key));
+    if (file.data() == nullptr || file.size() < sizeof(Header)) {
+        return false;
+    }
+
+    // Check the header before trusting the data, a different key in the file
+    // means its name was a collision or it was copied around
+    Header header;
+    std::memcpy(&header, file.data(), sizeof(Header));
+    if (std::memcmp(header.magic, "MSMC", 4) != 0 ||
+        header.version != kVersion || header.typeId != id.id() ||
+        header.key != key ||
+        file.size() - sizeof(Header) != header.length) {
+        return false;
+    }
+
+    MemoryBuffer buffer(file.data() + sizeof(Header), header.length);
+    std::istream in(&buffer);
+    return data.readBinary(in, header.length) == MS::kSuccess;
+}
+
+MStatus MappingFileCache::save(uint64_t key, const MTypeId &id,
+                               MPxData &data) const {
+    if (!isEnabled()) {
+        return MS::kSuccess;
+    }
+
+    std::ostringstream payload;
+    MStatus status = data.writeBinary(payload);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    std::string bytes = payload.str();
+
+    Header header;
+    std::memcpy(header.magic, "MSMC", 4);
+    header.version = kVersion;
+    header.typeId  = id.id();
+    header.length  = (uint32_t)bytes.size();
+    header.key     = key;
+
+    // Sessions writing the same mapping at once each write their own file,
+    // whichever is renamed last wins
+#ifdef _WIN32
+    unsigned long processId = GetCurrentProcessId();
+#else
+    unsigned long processId = (unsigned long)getpid();
+#endif
+    MString finalPath = path(key);
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%lu.tmp", processId);
+    MString tempPath = finalPath + suffix;
+    {
+        std::ofstream out(tempPath.asChar(), std::ios::binary);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+        out.write(bytes.data(), bytes.size());
+        if (!out) {
+            out.close();
+            std::remove(tempPath.asChar());
+            return MS::kFailure;
+        }
+    }
+#ifdef _WIN32
+    // rename won't replace an existing file here
+    std::remove(finalPath.asChar());
+#endif
+    if (std::rename(tempPath.asChar(), finalPath.asChar()) != 0) {
+        std::remove(tempPath.asChar());
+        return MS::kFailure;
+    }
+
+    return MS::kSuccess;
+}
+
+MString MappingFileCache::path(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016" PRIx64 ".msmap", key);
+    return m_directory + name;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include <maya/MTypeId.h>
+
+#include <maya/MPxData.h>
+
+/**
+ * A directory of meshSnap mappings saved by the command, one file per pair
+ * of meshes, so that snapping the same meshes again loads the mapping
+ * instead of building it.
+ *
+ * Files are named after a 64-bit key that the caller makes from everything
+ * the mapping depends on. Loading memory-maps the file and reads the data
+ * straight out of the mapping.
+ *
+ * File layout (little-endian):
+ *   char[4]  magic "MSMC"
+ *   uint32   version (1)
+ *   uint32   data type id
+ *   uint32   data length in bytes
+ *   uint64   key
+ *   char[]   the data as its writeBinary writes it
+ */
+class MappingFileCache {
+  public:
+    /**
+     * Use the given directory, which must already exist. An empty path
+     * disables the cache.
+     */
+    MappingFileCache(const MString &directory) : m_directory(directory){};
+
+    bool isEnabled() const { return m_directory.length() > 0; }
+
+    /**
+     * Read the mapping saved under key into data, which must be of type id.
+     * Returns false if there is no such mapping or the file is unusable.
+     */
+    bool load(uint64_t key, const MTypeId &id, MPxData &data) const;
+
+    /**
+     * Save data, of type id, under key. The file is written under a
+     * temporary name and renamed into place, so other sessions reading the
+     * cache never see half a file.
+     */
+    MStatus save(uint64_t key, const MTypeId &id, MPxData &data) const;
+
+  private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t typeId;
+        uint32_t length;
+        uint64_t key;
+    };
+
+    MString path(uint64_t key) const;
+
+    MString m_directory;
+};
@@ -0,0 +1,55 @@
+#include <cstring>
+
+#include "MeshHash.h"
+
+static const uint64_t kHashPrime = 1099511628211ULL;
+
+uint64_t hashWord(uint64_t hash, uint32_t word) {
+    return (hash ^ word) * kHashPrime;
+}
+
+static uint64_t hashDouble(uint64_t hash, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    hash = hashWord(hash, (uint32_t)bits);
+    return hashWord(hash, (uint32_t)(bits >> 32));
+}
+
+uint64_t hashArray(uint64_t hash, const MIntArray &array) {
+    for (unsigned int ii = 0; ii < array.length(); ++ii) {
+        hash = hashWord(hash, (uint32_t)array[ii]);
+    }
+    return hash;
+}
+
+uint64_t hashPoints(uint64_t hash, const MPointArray &points) {
+    hash = hashWord(hash, points.length());
+    for (unsigned int ii = 0; ii < points.length(); ++ii) {
+        hash = hashDouble(hash, points[ii].x);
+        hash = hashDouble(hash, points[ii].y);
+        hash = hashDouble(hash, points[ii].z);
+    }
+    return hash;
+}
+
+uint64_t hashMatrix(uint64_t hash, const MMatrix &matrix) {
+    for (unsigned int row = 0; row < 4; ++row) {
+        for (unsigned int column = 0; column < 4; ++column) {
+            hash = hashDouble(hash, matrix(row, column));
+        }
+    }
+    return hash;
+}
+
+MStatus topologyHash(const MFnMesh &fnMesh, uint64_t &hash) {
+    MStatus status;
+
+    MIntArray counts, connects;
+    status = fnMesh.getVertices(counts, connects);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    hash = hashWord(kHashOffset, (uint32_t)fnMesh.numVertices());
+    hash = hashArray(hash, counts);
+    hash = hashArray(hash, connects);
+
+    return MS::kSuccess;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+#include <maya/MFnMesh.h>
+#include <maya/MIntArray.h>
+#include <maya/MMatrix.h>
+#include <maya/MPointArray.h>
+#include <maya/MStatus.h>
+
+/**
+ * 64-bit FNV-1a hashes of mesh data, for telling whether a mesh changed
+ * since something was built from it. Each function folds more data into the
+ * given hash, start from kHashOffset.
+ */
+static const uint64_t kHashOffset = 14695981039346656037ULL;
+
+uint64_t hashWord(uint64_t hash, uint32_t word);
+uint64_t hashArray(uint64_t hash, const MIntArray &array);
+/**
+ * Folds in the exact bits of every coordinate, so only identical points hash
+ * the same.
+ */
+uint64_t hashPoints(uint64_t hash, const MPointArray &points);
+uint64_t hashMatrix(uint64_t hash, const MMatrix &matrix);
+
+/**
+ * Hash of the vertex count and face connectivity of a mesh.
+ */
+MStatus topologyHash(const MFnMesh &fnMesh, uint64_t &hash);
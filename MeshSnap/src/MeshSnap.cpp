@@ -1,27 +1,86 @@
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
+#include "MeshHash.h"
 #include "MeshSnap.h"
+#include "ParallelFor.h"
+#include "Timing.h"
+#include "VertexMapping.h"
+
+// Smallest number of mapped points worth handing to a worker thread
+static const unsigned int kMinBlockSize = 4096;
+// Number of pairs gathered into float streams at a time
+static const unsigned int kChunkSize = 256;
 
 MTypeId MeshSnap::id(0x00000426);
 MObject MeshSnap::aSnapMesh;
 MObject MeshSnap::aMapping;
+MObject MeshSnap::aLegacyMapping;
+MObject MeshSnap::aAutoRemap;
+MObject MeshSnap::aBindMode;
+MObject MeshSnap::aSurfaceBinding;
+MObject MeshSnap::aRbfBinding;
+
+MeshSnap::~MeshSnap() {
+    if (m_snapTopologyCallback) {
+        MMessage::removeCallback(m_snapTopologyCallback);
+    }
+}
 
 void *MeshSnap::creator() { return new MeshSnap(); }
 
 MStatus MeshSnap::initialize() {
     MFnTypedAttribute typedAttribute;
+    MFnNumericAttribute numericAttribute;
+    MFnEnumAttribute enumAttribute;
 
     aSnapMesh = typedAttribute.create("snapMesh", "snapMesh", MFnData::kMesh);
     addAttribute(aSnapMesh);
     attributeAffects(aSnapMesh, outputGeom);
 
-    aMapping = typedAttribute.create("vertexMapping", "vertexMapping",
-                                     MFnData::kIntArray);
+    aMapping = typedAttribute.create("vertexMappingData", "vertexMappingData",
+                                     VertexMappingData::id);
     typedAttribute.setHidden(true);
     typedAttribute.setConnectable(false);
     addAttribute(aMapping);
     attributeAffects(aMapping, outputGeom);
 
+    // The int array vertexMapping used to be stored as, kept under its old
+    // name so older scenes still load
+    aLegacyMapping = typedAttribute.create("vertexMapping", "vertexMapping",
+                                           MFnData::kIntArray);
+    typedAttribute.setHidden(true);
+    typedAttribute.setConnectable(false);
+    addAttribute(aLegacyMapping);
+    attributeAffects(aLegacyMapping, outputGeom);
+
+    aAutoRemap = numericAttribute.create("autoRemap", "ar",
+                                         MFnNumericData::kBoolean, 1);
+    addAttribute(aAutoRemap);
+    attributeAffects(aAutoRemap, outputGeom);
+
+    aBindMode = enumAttribute.create("bindMode", "bm", kVertex);
+    enumAttribute.addField("vertex", kVertex);
+    enumAttribute.addField("surface", kSurface);
+    enumAttribute.addField("rbf", kRbf);
+    addAttribute(aBindMode);
+    attributeAffects(aBindMode, outputGeom);
+
+    aSurfaceBinding = typedAttribute.create(
+        "surfaceBinding", "surfaceBinding", SurfaceBindingData::id);
+    typedAttribute.setHidden(true);
+    typedAttribute.setConnectable(false);
+    addAttribute(aSurfaceBinding);
+    attributeAffects(aSurfaceBinding, outputGeom);
+
+    aRbfBinding = typedAttribute.create("rbfBinding", "rbfBinding",
+                                        RbfBindingData::id);
+    typedAttribute.setHidden(true);
+    typedAttribute.setConnectable(false);
+    addAttribute(aRbfBinding);
+    attributeAffects(aRbfBinding, outputGeom);
+
     return MS::kSuccess;
 }
 
@@ -35,41 +94,479 @@ MStatus MeshSnap::deform(MDataBlock &data, MItGeometry &itGeo,
     // Get the snap mesh
     MObject oMesh = data.inputValue(aSnapMesh).asMesh();
 
-    // Get the vertex mapping
-    MObject oMapData = data.inputValue(aMapping).data();
+    // Get the vertex mapping or surface or RBF binding, this doesn't copy the
+    // arrays out of the data
+    BindMode bindMode = (BindMode)data.inputValue(aBindMode).asShort();
+    MObject aMapData  = bindMode == kSurface ? aSurfaceBinding
+                        : bindMode == kRbf ? aRbfBinding
+                                           : aMapping;
+    MObject oMapData = data.inputValue(aMapData).data();
+    if (bindMode == kVertex && oMapData.isNull()) {
+        status = legacyMapping(data, oMapData);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
 
     // Can't perform deformation in these cases
-    if (oMesh.isNull() || env == 0.0f || oMapData.isNull()) {
+    if (oMesh.isNull() || env == 0.0f) {
         return MS::kSuccess;
     }
 
-    MFnIntArrayData intData(oMapData, &status);
+    // Get all the input points at once
+    MPointArray points;
+    status = itGeo.allPositions(points);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    unsigned int numPoints = points.length();
+
+    // The points are in iteration order, which only matches the vertex order
+    // when the deformer affects every vertex. Get the input mesh, for its
+    // number of vertices, with outputArrayValue so as not to trigger another
+    // evaluation of the input.
+    MArrayDataHandle hInput = data.outputArrayValue(input, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    status = hInput.jumpToElement(geomIndex);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MFnMesh fnInputMesh(hInput.outputValue().child(inputGeom).asMesh(),
+                        &status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
-    MIntArray vertexMapping = intData.array();
 
-    // Get vertices to snap to from snap mesh
     MFnMesh fnMesh(oMesh, &status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
-    MPointArray snapVertices;
-    fnMesh.getPoints(snapVertices, MSpace::kWorld);
-    unsigned int numSnapVerts = snapVertices.length();
-
-    MMatrix worldToLocalMatrix = localToWorldMatrix.inverse();
-    MPoint pt;
-    int snapVertexIndex;
-    for (itGeo.reset(); !itGeo.isDone(); itGeo.next()) {
-        pt              = itGeo.position();
-        snapVertexIndex = vertexMapping[itGeo.index()];
-        if (snapVertexIndex != -1) {
-            // Transform snap point from world-space to local space and perform
-            // snapping in local space (itGeo.setPosition performed in local
-            // space)
-            pt = pt +
-                 (((snapVertices[snapVertexIndex] * worldToLocalMatrix) - pt) *
-                  env);
+    MMatrix snapMatrix;
+    MFnGeometryData fnSnapData(oMesh, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    status = fnSnapData.getMatrix(snapMatrix);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    // Build a new mapping if either mesh was retopologised since the mapping
+    // was made
+    if (data.inputValue(aAutoRemap).asBool()) {
+        status = remapIfChanged(geomIndex, bindMode, fnMesh, snapMatrix,
+                                fnInputMesh, localToWorldMatrix, oMapData);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+    if (oMapData.isNull()) {
+        return MS::kSuccess;
+    }
+
+    // Only the mapped points are visited, the pairs are only rebuilt when the
+    // mapping is dirtied. The vertex index of each point is only gathered
+    // when the mapping or the input geometry were dirtied, not when just the
+    // snap mesh moved.
+    MappingCache &cache = m_mappingCaches[geomIndex];
+    std::vector<int> indices;
+    if (cache.needsIndices(numPoints) &&
+        numPoints != (unsigned int)fnInputMesh.numVertices()) {
+        indices.reserve(numPoints);
+        for (itGeo.reset(); !itGeo.isDone(); itGeo.next()) {
+            indices.push_back(itGeo.index());
         }
-        itGeo.setPosition(pt);
     }
+    status = cache.update(oMapData, numPoints, indices);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    const std::vector<unsigned int> &mappedPoints = cache.points();
+    bool surface                                  = cache.isSurface();
+    const std::vector<unsigned int> &snapIndices  = cache.snapIndices(0);
+    const std::vector<unsigned int> &snapIndicesB = cache.snapIndices(1);
+    const std::vector<unsigned int> &snapIndicesC = cache.snapIndices(2);
+    const std::vector<float> &weightsA            = cache.weights(0);
+    const std::vector<float> &weightsB            = cache.weights(1);
+    unsigned int rbfK                             = cache.rbfK();
+    const std::vector<unsigned int> &rbfIndices   = cache.rbfIndices();
+    const std::vector<float> &rbfWeights          = cache.rbfWeights();
+    const std::vector<float> &offsets             = cache.offsets();
+    unsigned int numPairs                         = mappedPoints.size();
+    if (numPairs == 0) {
+        return MS::kSuccess;
+    }
+
+    // Get vertices to snap to from snap mesh, in its own object space
+    if (cache.maxSnapIndex() >= fnMesh.numVertices()) {
+        // Mapping was made for a different snap mesh
+        return MS::kSuccess;
+    }
+    const float *snapVertices = fnMesh.getRawPoints(&status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    // One matrix takes the snap vertices from the snap mesh's object space,
+    // through world space, to our object space (setAllPositions works in
+    // local space)
+    MMatrix snapToLocalMatrix = snapMatrix * localToWorldMatrix.inverse();
+    float m[4][3];
+    for (unsigned int row = 0; row < 4; ++row) {
+        for (unsigned int column = 0; column < 3; ++column) {
+            m[row][column] = (float)snapToLocalMatrix(row, column);
+        }
+    }
+
+    // Gather each chunk of pairs into float streams so the transform and
+    // blend run over contiguous data, then scatter the results back. Surface
+    // and RBF bindings are evaluated while gathering, the snap matrix is
+    // affine and their weights add up to one so it can be applied after them.
+    TIME_SCOPE("meshSnap deform", numPairs);
+    parallelFor(numPairs, kMinBlockSize, [&](unsigned int begin,
+                                             unsigned int end) {
+        alignas(64) float sx[kChunkSize], sy[kChunkSize], sz[kChunkSize];
+        alignas(64) float px[kChunkSize], py[kChunkSize], pz[kChunkSize];
+
+        for (unsigned int chunk = begin; chunk < end; chunk += kChunkSize) {
+            unsigned int count = std::min(kChunkSize, end - chunk);
+            if (surface) {
+                for (unsigned int kk = 0; kk < count; ++kk) {
+                    unsigned int pair = chunk + kk;
+                    const float *a    = snapVertices + snapIndices[pair] * 3;
+                    const float *b    = snapVertices + snapIndicesB[pair] * 3;
+                    const float *c    = snapVertices + snapIndicesC[pair] * 3;
+                    float wa          = weightsA[pair];
+                    float wb          = weightsB[pair];
+                    float wc          = 1.0f - wa - wb;
+                    sx[kk]            = a[0] * wa + b[0] * wb + c[0] * wc;
+                    sy[kk]            = a[1] * wa + b[1] * wb + c[1] * wc;
+                    sz[kk]            = a[2] * wa + b[2] * wb + c[2] * wc;
+                }
+            } else if (rbfK > 0) {
+                // A fixed size row of the sparse weight matrix per point
+                for (unsigned int kk = 0; kk < count; ++kk) {
+                    unsigned int pair       = chunk + kk;
+                    const unsigned int *row = &rbfIndices[pair * rbfK];
+                    const float *weights    = &rbfWeights[pair * rbfK];
+                    const float *offset     = &offsets[pair * 3];
+                    float x                 = offset[0];
+                    float y                 = offset[1];
+                    float z                 = offset[2];
+                    for (unsigned int jj = 0; jj < rbfK; ++jj) {
+                        const float *snap = snapVertices + row[jj] * 3;
+                        x += snap[0] * weights[jj];
+                        y += snap[1] * weights[jj];
+                        z += snap[2] * weights[jj];
+                    }
+                    sx[kk] = x;
+                    sy[kk] = y;
+                    sz[kk] = z;
+                }
+            } else {
+                for (unsigned int kk = 0; kk < count; ++kk) {
+                    const float *snap =
+                        snapVertices + snapIndices[chunk + kk] * 3;
+                    sx[kk] = snap[0];
+                    sy[kk] = snap[1];
+                    sz[kk] = snap[2];
+                }
+            }
+            for (unsigned int kk = 0; kk < count; ++kk) {
+                const MPoint &point = points[mappedPoints[chunk + kk]];
+                px[kk]              = (float)point.x;
+                py[kk]              = (float)point.y;
+                pz[kk]              = (float)point.z;
+            }
+
+            for (unsigned int kk = 0; kk < count; ++kk) {
+                float x = sx[kk] * m[0][0] + sy[kk] * m[1][0] +
+                          sz[kk] * m[2][0] + m[3][0];
+                float y = sx[kk] * m[0][1] + sy[kk] * m[1][1] +
+                          sz[kk] * m[2][1] + m[3][1];
+                float z = sx[kk] * m[0][2] + sy[kk] * m[1][2] +
+                          sz[kk] * m[2][2] + m[3][2];
+                px[kk] += (x - px[kk]) * env;
+                py[kk] += (y - py[kk]) * env;
+                pz[kk] += (z - pz[kk]) * env;
+            }
+
+            for (unsigned int kk = 0; kk < count; ++kk) {
+                MPoint &point = points[mappedPoints[chunk + kk]];
+                point.x       = px[kk];
+                point.y       = py[kk];
+                point.z       = pz[kk];
+            }
+        }
+    });
+
+    status = itGeo.setAllPositions(points);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    return MS::kSuccess;
+}
+
+MStatus MeshSnap::setDependentsDirty(const MPlug &plug,
+                                     MPlugArray &plugArray) {
+    // The compacted pairs are built from the mapping, and a new mapping
+    // replaces any the node built itself
+    if (plug == aMapping || plug == aLegacyMapping ||
+        plug == aSurfaceBinding || plug == aRbfBinding || plug == aBindMode) {
+        setMappingsDirty();
+        m_remaps.clear();
+        if (plug == aLegacyMapping) {
+            m_legacyMapData = MObject::kNullObj;
+        }
+    } else if (plug == aAutoRemap) {
+        // Switching between our mapping and the attribute's
+        setMappingsDirty();
+    } else if (plug == input || plug == inputGeom || plug == groupId) {
+        // The deformer set's membership may have changed
+        setMappingPointsDirty();
+    } else if (plug == aSnapMesh && !m_snapTopologyCallback) {
+        // Nothing tells us when an unwatched snap mesh changes topology
+        ++m_snapTopologyVersion;
+    }
+
+    return MPxDeformerNode::setDependentsDirty(plug, plugArray);
+}
+
+MStatus MeshSnap::preEvaluation(const MDGContext &context,
+                                const MEvaluationNode &evaluationNode) {
+    // setDependentsDirty isn't called while the evaluation manager is playing
+    // back, so check what it dirtied here as well
+    if (context.isNormal() &&
+        (evaluationNode.dirtyPlugExists(aMapping) ||
+         evaluationNode.dirtyPlugExists(aLegacyMapping) ||
+         evaluationNode.dirtyPlugExists(aSurfaceBinding) ||
+         evaluationNode.dirtyPlugExists(aRbfBinding) ||
+         evaluationNode.dirtyPlugExists(aBindMode))) {
+        setMappingsDirty();
+        m_remaps.clear();
+    }
+    if (context.isNormal() && evaluationNode.dirtyPlugExists(aLegacyMapping)) {
+        m_legacyMapData = MObject::kNullObj;
+    }
+    if (context.isNormal() && (evaluationNode.dirtyPlugExists(input) ||
+                               evaluationNode.dirtyPlugExists(inputGeom) ||
+                               evaluationNode.dirtyPlugExists(groupId))) {
+        setMappingPointsDirty();
+    }
+    if (context.isNormal() && !m_snapTopologyCallback &&
+        evaluationNode.dirtyPlugExists(aSnapMesh)) {
+        ++m_snapTopologyVersion;
+    }
+
+    return MPxDeformerNode::preEvaluation(context, evaluationNode);
+}
+
+MStatus MeshSnap::connectionMade(const MPlug &plug, const MPlug &otherPlug,
+                                 bool asSrc) {
+    if (plug == aSnapMesh && !asSrc) {
+        watchSnapTopology(otherPlug.node());
+    }
+
+    return MPxDeformerNode::connectionMade(plug, otherPlug, asSrc);
+}
+
+MStatus MeshSnap::connectionBroken(const MPlug &plug, const MPlug &otherPlug,
+                                   bool asSrc) {
+    if (plug == aSnapMesh && !asSrc) {
+        watchSnapTopology(MObject::kNullObj);
+    }
+
+    return MPxDeformerNode::connectionBroken(plug, otherPlug, asSrc);
+}
+
+void MeshSnap::watchSnapTopology(const MObject &oSnapNode) {
+    if (m_snapTopologyCallback) {
+        MMessage::removeCallback(m_snapTopologyCallback);
+        m_snapTopologyCallback = 0;
+    }
+    // A different mesh, or none, needs checking again
+    ++m_snapTopologyVersion;
+
+    if (oSnapNode.isNull() || !oSnapNode.hasFn(MFn::kMesh)) {
+        return;
+    }
+    MStatus status;
+    MObject oMesh(oSnapNode);
+    m_snapTopologyCallback = MPolyMessage::addPolyTopologyChangedCallback(
+        oMesh, &MeshSnap::snapTopologyChanged, (void *)this, &status);
+    if (!status) {
+        m_snapTopologyCallback = 0;
+    }
+}
+
+void MeshSnap::snapTopologyChanged(MObject &node, void *clientData) {
+    ++static_cast<MeshSnap *>(clientData)->m_snapTopologyVersion;
+}
+
+void MeshSnap::setMappingsDirty() {
+    std::map<unsigned int, MappingCache>::iterator it;
+    for (it = m_mappingCaches.begin(); it != m_mappingCaches.end(); ++it) {
+        it->second.setDirty();
+    }
+}
+
+void MeshSnap::setMappingPointsDirty() {
+    std::map<unsigned int, MappingCache>::iterator it;
+    for (it = m_mappingCaches.begin(); it != m_mappingCaches.end(); ++it) {
+        it->second.setPointsDirty();
+    }
+}
+
+MStatus MeshSnap::legacyMapping(MDataBlock &data, MObject &oMapData) {
+    MStatus status;
+
+    if (!m_legacyMapData.isNull()) {
+        oMapData = m_legacyMapData;
+        return MS::kSuccess;
+    }
+
+    MObject oLegacyData = data.inputValue(aLegacyMapping, &status).data();
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    if (oLegacyData.isNull()) {
+        return MS::kSuccess;
+    }
+    MFnIntArrayData fnLegacyData(oLegacyData, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MIntArray vertexMapping = fnLegacyData.array();
+    if (vertexMapping.length() == 0) {
+        return MS::kSuccess;
+    }
+
+    MFnPluginData fnMapData;
+    oMapData = fnMapData.create(VertexMappingData::id, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    VertexMappingData *mapData =
+        static_cast<VertexMappingData *>(fnMapData.data(&status));
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    mapData->set(vertexMapping);
+
+    // Only kept on the node, the attributes are inputs and are left as they
+    // are. The array is converted again when it is dirtied.
+    m_legacyMapData = oMapData;
+
+    return MS::kSuccess;
+}
+
+MStatus MeshSnap::remapIfChanged(unsigned int geomIndex, BindMode bindMode,
+                                 MFnMesh &fnSnapMesh,
+                                 const MMatrix &snapMatrix,
+                                 MFnMesh &fnInputMesh,
+                                 const MMatrix &localToWorldMatrix,
+                                 MObject &oMapData) {
+    MStatus status;
+
+    // Hashing the snap mesh's topology means copying out every face, so
+    // only do it after the snap mesh's topology may have changed (see
+    // watchSnapTopology) or the vertex counts say either mesh did. Edits
+    // that keep the counts, like spinning an edge, still change the version.
+    Remap &remap            = m_remaps[geomIndex];
+    int numBaseVertices     = fnInputMesh.numVertices();
+    int numSnapVertices     = fnSnapMesh.numVertices();
+    int numSnapFaceVertices = fnSnapMesh.numFaceVertices();
+    if (remap.valid && remap.snapTopologyVersion == m_snapTopologyVersion &&
+        numBaseVertices == remap.numBaseVertices &&
+        numSnapVertices == remap.numSnapVertices &&
+        numSnapFaceVertices == remap.numSnapFaceVertices) {
+        // Nothing changed, keep using whichever mapping we were using
+        if (!remap.oMapData.isNull()) {
+            oMapData = remap.oMapData;
+        }
+        return MS::kSuccess;
+    }
+
+    uint64_t snapTopologyHash;
+    status = topologyHash(fnSnapMesh, snapTopologyHash);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    remap.valid               = true;
+    remap.snapTopologyVersion = m_snapTopologyVersion;
+    remap.numBaseVertices     = numBaseVertices;
+    remap.numSnapVertices     = numSnapVertices;
+    remap.numSnapFaceVertices = numSnapFaceVertices;
+
+    // The mapping in the attribute remembers the meshes it was made for, and
+    // is saved with the scene, so it can be checked however long ago it was
+    // made
+    if (!oMapData.isNull()) {
+        MFnPluginData fnOldData(oMapData, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        const MappingData *oldData =
+            static_cast<const MappingData *>(fnOldData.constData());
+        if (oldData->fits(numBaseVertices, snapTopologyHash)) {
+            if (!remap.oMapData.isNull()) {
+                // Back to the meshes the attribute's mapping was made for
+                remap.oMapData = MObject::kNullObj;
+                m_mappingCaches[geomIndex].setDirty();
+            }
+            return MS::kSuccess;
+        }
+    }
+
+    TIME_SCOPE("meshSnap remap");
+
+    // Both meshes in world space, as the command maps them
+    MPointArray basePoints;
+    status = fnInputMesh.getPoints(basePoints);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    for (unsigned int ii = 0; ii < basePoints.length(); ++ii) {
+        basePoints[ii] *= localToWorldMatrix;
+    }
+
+    MFnPluginData fnMapData;
+    if (bindMode == kSurface) {
+        SurfaceBinder binder;
+        status = binder.create(fnSnapMesh.object(), snapMatrix);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        remap.oMapData = fnMapData.create(SurfaceBindingData::id, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        SurfaceBindingData *bindData =
+            static_cast<SurfaceBindingData *>(fnMapData.data(&status));
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        binder.bind(basePoints, *bindData);
+        bindData->setSnapTopologyHash(snapTopologyHash);
+    } else {
+        MPointArray snapPoints;
+        status = fnSnapMesh.getPoints(snapPoints);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        for (unsigned int ii = 0; ii < snapPoints.length(); ++ii) {
+            snapPoints[ii] *= snapMatrix;
+        }
+
+        if (bindMode == kRbf) {
+            status = rebindRbf(basePoints, snapPoints, snapMatrix,
+                               snapTopologyHash, oMapData, remap.oMapData);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+        } else {
+            MIntArray vertexMapping;
+            calculateVertexMapping(basePoints, snapPoints, vertexMapping);
+            remap.oMapData = fnMapData.create(VertexMappingData::id, &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            VertexMappingData *mapData =
+                static_cast<VertexMappingData *>(fnMapData.data(&status));
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            mapData->set(vertexMapping);
+            mapData->setSnapTopologyHash(snapTopologyHash);
+        }
+    }
+    oMapData = remap.oMapData;
+
+    // The compacted pairs need rebuilding from the new mapping
+    m_mappingCaches[geomIndex].setDirty();
+
+    return MS::kSuccess;
+}
+
+MStatus MeshSnap::rebindRbf(const MPointArray &basePoints,
+                            const MPointArray &snapPoints,
+                            const MMatrix &snapMatrix,
+                            uint64_t snapTopologyHash,
+                            const MObject &oOldData, MObject &oBindData) {
+    MStatus status;
+
+    // Keep binding to as many neighbours as the command did
+    unsigned int k = kDefaultRbfNeighbours;
+    if (!oOldData.isNull()) {
+        MFnPluginData fnOldData(oOldData, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        if (fnOldData.typeId() == RbfBindingData::id) {
+            k = static_cast<const RbfBindingData *>(fnOldData.constData())
+                    ->k();
+        }
+    }
+
+    RbfBinder binder;
+    binder.create(snapPoints, snapMatrix.inverse());
+    MFnPluginData fnBindData;
+    oBindData = fnBindData.create(RbfBindingData::id, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    RbfBindingData *bindData =
+        static_cast<RbfBindingData *>(fnBindData.data(&status));
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    binder.bind(basePoints, k, *bindData);
+    bindData->setSnapTopologyHash(snapTopologyHash);
 
     return MS::kSuccess;
 }
@@ -1,22 +1,40 @@
 #pragma once
 
+#include <cstdint>
+#include <map>
+
 #include <maya/MDagModifier.h>
 #include <maya/MDataBlock.h>
+#include <maya/MDGContext.h>
 #include <maya/MDataHandle.h>
+#include <maya/MEvaluationNode.h>
 #include <maya/MGlobal.h>
 #include <maya/MItGeometry.h>
+#include <maya/MMessage.h>
+#include <maya/MIntArray.h>
 #include <maya/MMatrix.h>
+#include <maya/MPlug.h>
+#include <maya/MPlugArray.h>
 #include <maya/MPointArray.h>
+#include <maya/MPolyMessage.h>
 #include <maya/MStatus.h>
 
+#include <maya/MFnGeometryData.h>
+#include <maya/MFnEnumAttribute.h>
 #include <maya/MFnIntArrayData.h>
 #include <maya/MFnMatrixAttribute.h>
 #include <maya/MFnMesh.h>
 #include <maya/MFnNumericAttribute.h>
+#include <maya/MFnPluginData.h>
 #include <maya/MFnTypedAttribute.h>
 
 #include <maya/MPxDeformerNode.h>
 
+#include "MappingCache.h"
+#include "RbfBindingData.h"
+#include "SurfaceBindingData.h"
+#include "VertexMappingData.h"
+
 /**
  * Snap the vertices of one mesh to another's.
  *
@@ -25,21 +43,121 @@
  *
  * Attributes:
  *   snapMesh (snapMesh) - Mesh to snap to.
- *   mappint (mapping) - Used to decide which vertex on the snap mesh should
- *   correspond to which vertex on the snapped mesh.
+ *   vertexMappingData (vertexMappingData) - Used to decide which vertex on
+ *   the snap mesh should correspond to which vertex on the snapped mesh, as
+ *   meshSnapMapping data.
+ *   vertexMapping (vertexMapping) - int array, the mapping as older scenes
+ *   stored it, one snap vertex (or -1) per vertex. Used when there is no
+ *   vertexMappingData, converted once and kept until it is changed.
+ *   autoRemap (ar) - bool, build a new mapping when the topology of either
+ *   mesh changes. On by default.
+ *   bindMode (bm) - enum, vertex snaps each mapped vertex to one snap
+ *   vertex, surface moves every vertex with the point on the snap mesh it
+ *   was closest to when bound, rbf moves every vertex with a radial basis
+ *   function blend of its nearest snap vertices.
+ *   surfaceBinding (surfaceBinding) - Triangle and barycentric coordinates
+ *   of each vertex for the surface bind mode, as meshSnapSurfaceBinding
+ *   data.
+ *   rbfBinding (rbfBinding) - Nearest snap vertices, weights and offset of
+ *   each vertex for the rbf bind mode, as meshSnapRbfBinding data.
  */
 class MeshSnap : public MPxDeformerNode {
   public:
-    MeshSnap(){};
-    virtual ~MeshSnap(){};
+    MeshSnap() : m_snapTopologyCallback(0), m_snapTopologyVersion(1){};
+    virtual ~MeshSnap();
     static void *creator();
     static MStatus initialize();
 
     virtual MStatus deform(MDataBlock &data, MItGeometry &itGeo,
                            const MMatrix &localToWorldMatrix,
                            unsigned int geomIndex) override;
+    virtual MStatus setDependentsDirty(const MPlug &plug,
+                                       MPlugArray &plugArray) override;
+    virtual MStatus
+    preEvaluation(const MDGContext &context,
+                  const MEvaluationNode &evaluationNode) override;
+    virtual MStatus connectionMade(const MPlug &plug, const MPlug &otherPlug,
+                                   bool asSrc) override;
+    virtual MStatus connectionBroken(const MPlug &plug,
+                                     const MPlug &otherPlug,
+                                     bool asSrc) override;
 
     static MTypeId id;
     static MObject aSnapMesh;
     static MObject aMapping;
+    static MObject aLegacyMapping;
+    static MObject aAutoRemap;
+    static MObject aBindMode;
+    static MObject aSurfaceBinding;
+    static MObject aRbfBinding;
+
+    enum BindMode { kVertex = 0, kSurface = 1, kRbf = 2 };
+
+  private:
+    void setMappingsDirty();
+    void setMappingPointsDirty();
+    /**
+     * Watch the mesh connected to snapMesh for topology changes, so that
+     * its topology is only hashed again after one. Meshes fed in from
+     * anything other than a mesh shape can't be watched, their topology is
+     * hashed again whenever snapMesh is dirtied instead.
+     */
+    void watchSnapTopology(const MObject &oSnapNode);
+    static void snapTopologyChanged(MObject &node, void *clientData);
+    /**
+     * Convert the mapping in the legacy vertexMapping int array, if there
+     * is one, into meshSnapMapping data in oMapData. Only reads the data
+     * block, the converted mapping is kept on the node until the array is
+     * dirtied.
+     */
+    MStatus legacyMapping(MDataBlock &data, MObject &oMapData);
+    /**
+     * Build a new mapping (or surface or RBF binding) for the given geometry
+     * if the snap mesh's topology or the number of vertices on the geometry
+     * no longer match the ones the mapping in oMapData was made for, and
+     * replace oMapData with the mapping to use. The topology is only hashed
+     * again when the vertex or face vertex counts change.
+     */
+    MStatus remapIfChanged(unsigned int geomIndex, BindMode bindMode,
+                           MFnMesh &fnSnapMesh, const MMatrix &snapMatrix,
+                           MFnMesh &fnInputMesh,
+                           const MMatrix &localToWorldMatrix,
+                           MObject &oMapData);
+    /**
+     * Bind basePoints to snapPoints (both in world space) as an RBF binding
+     * in oBindData, using as many neighbours per point as oOldData if it is
+     * an RBF binding.
+     */
+    MStatus rebindRbf(const MPointArray &basePoints,
+                      const MPointArray &snapPoints, const MMatrix &snapMatrix,
+                      uint64_t snapTopologyHash, const MObject &oOldData,
+                      MObject &oBindData);
+
+    // A mapping the node built itself, and the mesh sizes it last checked
+    // the mapping in use against
+    struct Remap {
+        Remap()
+            : valid(false), snapTopologyVersion(0), numBaseVertices(0),
+              numSnapVertices(0), numSnapFaceVertices(0){};
+
+        bool valid;
+        unsigned int snapTopologyVersion;
+        int numBaseVertices;
+        int numSnapVertices;
+        int numSnapFaceVertices;
+        // Null while the vertexMapping attribute is still good
+        MObject oMapData;
+    };
+
+    // Compacted mapping for each input geometry index
+    std::map<unsigned int, MappingCache> m_mappingCaches;
+    // Rebuilt mappings for each input geometry index
+    std::map<unsigned int, Remap> m_remaps;
+    // Topology changed callback on the snap mesh shape, 0 if it isn't
+    // watched, and a count of the changes it may have had
+    MCallbackId m_snapTopologyCallback;
+    unsigned int m_snapTopologyVersion;
+    // The legacy vertexMapping array converted to meshSnapMapping data, null
+    // until it is needed
+    MObject m_legacyMapData;
 };
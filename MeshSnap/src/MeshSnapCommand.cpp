@@ -1,7 +1,12 @@
 #include <cstdio>
+#include <cstdlib>
 
-#include "MeshSnap.h"
+#include <maya/MThreadUtils.h>
+
+#include "MeshHash.h"
 #include "MeshSnapCommand.h"
+#include "Timing.h"
+#include "VertexMapping.h"
 
 MStatus MeshSnapCommand::doIt(const MArgList &argList) {
     MStatus status;
@@ -14,19 +19,167 @@ MStatus MeshSnapCommand::doIt(const MArgList &argList) {
     MSelectionList selection;
     status = argData.getObjects(selection);
     CHECK_MSTATUS_AND_RETURN_IT(status);
-    status = selection.getDagPath(0, m_pathBaseMesh);
+    // Every object but the last is a mesh to snap, the last is the mesh to
+    // snap to
+    unsigned int numBaseMeshes = selection.length() - 1;
+    m_pathBaseMeshes.resize(numBaseMeshes);
+    for (unsigned int ii = 0; ii < numBaseMeshes; ++ii) {
+        status = selection.getDagPath(ii, m_pathBaseMeshes[ii]);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        status = MeshSnapCommand::getShapeNode(m_pathBaseMeshes[ii]);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+    status = selection.getDagPath(numBaseMeshes, m_pathSnapMesh);
     CHECK_MSTATUS_AND_RETURN_IT(status);
-    status = selection.getDagPath(1, m_pathSnapMesh);
+    status = MeshSnapCommand::getShapeNode(m_pathSnapMesh);
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
-    status = MeshSnapCommand::getShapeNode(m_pathBaseMesh);
-    CHECK_MSTATUS_AND_RETURN_IT(status);
-    status = MeshSnapCommand::getShapeNode(m_pathSnapMesh);
+    if (argData.isFlagSet("-bm")) {
+        MString bindMode = argData.flagArgumentString("-bm", 0, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        if (bindMode == "surface") {
+            m_bindMode = MeshSnap::kSurface;
+        } else if (bindMode == "rbf") {
+            m_bindMode = MeshSnap::kRbf;
+        } else if (bindMode != "vertex") {
+            MGlobal::displayError("meshSnap: -bindMode must be vertex, "
+                                  "surface or rbf");
+            return MS::kInvalidParameter;
+        }
+    }
+
+    if (argData.isFlagSet("-nb")) {
+        int neighbours = argData.flagArgumentInt("-nb", 0, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        if (neighbours < 1 || neighbours > (int)kMaxRbfNeighbours) {
+            MString message("meshSnap: -neighbours must be from 1 to ");
+            message += (int)kMaxRbfNeighbours;
+            MGlobal::displayError(message);
+            return MS::kInvalidParameter;
+        }
+        m_neighbours = neighbours;
+    }
+
+    double tolerance = 0.0;
+    if (argData.isFlagSet("-tol")) {
+        tolerance = argData.flagArgumentDouble("-tol", 0, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+
+    MString cacheDirectory;
+    if (argData.isFlagSet("-cd")) {
+        cacheDirectory = argData.flagArgumentString("-cd", 0, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    } else if (const char *directory = std::getenv("MESHSNAP_CACHE_DIR")) {
+        cacheDirectory = directory;
+    }
+    MappingFileCache fileCache(cacheDirectory);
+
+    std::vector<MPointArray> basePoints;
+    status = getBasePoints(basePoints);
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
-    status = calculateVertexMapping();
+    // Every mapping remembers the snap mesh topology it was made for, so the
+    // node can tell when it no longer fits, even after the scene is reopened
+    MFnMesh fnSnapMesh(m_pathSnapMesh, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    uint64_t snapTopologyHash;
+    status = topologyHash(fnSnapMesh, snapTopologyHash);
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
+    // Load whatever earlier runs on the same meshes already saved, only the
+    // rest need building
+    m_mapData.assign(numBaseMeshes, MObject::kNullObj);
+    std::vector<uint64_t> keys;
+    std::vector<unsigned int> pending;
+    if (fileCache.isEnabled()) {
+        status = getMappingKeys(basePoints, keys);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
+    for (unsigned int ii = 0; ii < numBaseMeshes; ++ii) {
+        if (fileCache.isEnabled()) {
+            MFnPluginData fnMapData;
+            MObject oMapData = fnMapData.create(mapDataId(), &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            MappingData *mapData =
+                static_cast<MappingData *>(fnMapData.data(&status));
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            if (fileCache.load(keys[ii], mapDataId(), *mapData)) {
+                // Cached files from before the hash was stored lack it
+                mapData->setSnapTopologyHash(snapTopologyHash);
+                m_mapData[ii] = oMapData;
+                continue;
+            }
+        }
+        pending.push_back(ii);
+    }
+
+    if (!pending.empty()) {
+        std::vector<MPointArray> pendingPoints(pending.size());
+        for (size_t ii = 0; ii < pending.size(); ++ii) {
+            pendingPoints[ii] = basePoints[pending[ii]];
+        }
+        basePoints.clear();
+
+        // Mapping scans can take a while, so show progress and let the user
+        // interrupt. Nothing in the scene has changed yet, stopping here
+        // leaves it as it was.
+        MappingProgress progress;
+        std::vector<MObject> mapData;
+        bool finished;
+        if (m_bindMode == MeshSnap::kSurface) {
+            status = calculateSurfaceBindings(pendingPoints, progress, mapData,
+                                              finished);
+        } else if (m_bindMode == MeshSnap::kRbf) {
+            status = calculateRbfBindings(pendingPoints, progress, mapData,
+                                          finished);
+        } else {
+            status = calculateVertexMappings(pendingPoints, tolerance,
+                                             progress, mapData, finished);
+        }
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        if (!finished) {
+            MGlobal::displayWarning(
+                "meshSnap: interrupted, nothing was changed");
+            return MS::kFailure;
+        }
+
+        // The resident growth is what was actually used, the estimate only
+        // covers the buffers the mapping code allocates itself
+        const double kMB = 1024.0 * 1024.0;
+        MString memoryMessage("meshSnap: resident memory grew by up to ");
+        memoryMessage += (double)progress.peakResidentGrowth() / kMB;
+        memoryMessage += " MB, plugin mapping buffers estimated at up to ";
+        memoryMessage += (double)progress.peakBytes() / kMB;
+        memoryMessage += " MB";
+        MGlobal::displayInfo(memoryMessage);
+
+        for (size_t ii = 0; ii < pending.size(); ++ii) {
+            MFnPluginData fnMapData(mapData[ii], &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            MappingData *data = static_cast<MappingData *>(fnMapData.data());
+            data->setSnapTopologyHash(snapTopologyHash);
+            m_mapData[pending[ii]] = mapData[ii];
+            if (!fileCache.isEnabled()) {
+                continue;
+            }
+            status = fileCache.save(keys[pending[ii]], mapDataId(), *data);
+            if (!status) {
+                MGlobal::displayWarning("meshSnap: couldn't save mapping to " +
+                                        cacheDirectory);
+            }
+        }
+    }
+    if (fileCache.isEnabled()) {
+        MString cacheMessage("meshSnap: loaded ");
+        cacheMessage += (int)(numBaseMeshes - pending.size());
+        cacheMessage += " of ";
+        cacheMessage += (int)numBaseMeshes;
+        cacheMessage += " mappings from ";
+        cacheMessage += cacheDirectory;
+        MGlobal::displayInfo(cacheMessage);
+    }
+
     if (argData.isFlagSet("-n")) {
         m_name = argData.flagArgumentString("-n", 0, &status);
         CHECK_MSTATUS_AND_RETURN_IT(status);
@@ -34,93 +187,212 @@ MStatus MeshSnapCommand::doIt(const MArgList &argList) {
         m_name = "meshSnap#";
     }
 
-    // Fill DG modifier with commands
-    char buffer[512];
-    snprintf(buffer, sizeof(buffer), "deformer -type meshSnap -n \"%s\" %s",
-             m_name.asChar(), m_pathBaseMesh.partialPathName().asChar());
-    status = m_dgMod.commandToExecute(buffer);
-    CHECK_MSTATUS_AND_RETURN_IT(status);
+    // Fill DG modifier with commands, one deformer per base mesh so that
+    // undo removes all of them together
+    for (unsigned int ii = 0; ii < numBaseMeshes; ++ii) {
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer),
+                 "deformer -type meshSnap -n \"%s\" %s", m_name.asChar(),
+                 m_pathBaseMeshes[ii].partialPathName().asChar());
+        status = m_dgMod.commandToExecute(buffer);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
 
     return redoIt();
 }
 
-MStatus MeshSnapCommand::calculateVertexMapping() {
+MStatus MeshSnapCommand::calculateVertexMappings(
+    const std::vector<MPointArray> &basePoints, double tolerance,
+    MappingProgress &progress, std::vector<MObject> &mapData,
+    bool &finished) {
     MStatus status;
 
-    MFnMesh fnBaseMesh(m_pathBaseMesh, &status);
+    MString label("meshSnap vertex mapping (");
+    label += (int)basePoints.size();
+    label += " meshes, ";
+    label += MThreadUtils::getNumThreads();
+    label += " threads)";
+    TIME_SCOPE(label);
+
+    // The snap mesh is only read once however many meshes snap to it
+    MFnMesh fnSnapMesh(m_pathSnapMesh, &status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
-    MPointArray basePoints;
-    status = fnBaseMesh.getPoints(basePoints, MSpace::kWorld);
+    MPointArray snapPoints;
+    status = fnSnapMesh.getPoints(snapPoints, MSpace::kWorld);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    std::vector<MIntArray> vertexMappings;
+    progress.begin((uint64_t)basePoints.size() * snapPoints.length());
+    finished = ::calculateVertexMappings(basePoints, snapPoints,
+                                         vertexMappings, tolerance, &progress);
+    progress.end();
+    if (!finished) {
+        return MS::kSuccess;
+    }
+
+    mapData.resize(vertexMappings.size());
+    for (size_t ii = 0; ii < vertexMappings.size(); ++ii) {
+        MFnPluginData fnMapData;
+        mapData[ii] = fnMapData.create(VertexMappingData::id, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        VertexMappingData *vertexMapping =
+            static_cast<VertexMappingData *>(fnMapData.data(&status));
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        vertexMapping->set(vertexMappings[ii]);
+    }
+
+    return MS::kSuccess;
+}
+
+MStatus MeshSnapCommand::calculateSurfaceBindings(
+    const std::vector<MPointArray> &basePoints, MappingProgress &progress,
+    std::vector<MObject> &mapData, bool &finished) {
+    MStatus status;
+
+    MString label("meshSnap surface binding (");
+    label += (int)basePoints.size();
+    label += " meshes, ";
+    label += MThreadUtils::getNumThreads();
+    label += " threads)";
+    TIME_SCOPE(label);
+
+    // One closest point structure over the snap mesh serves every base mesh
+    SurfaceBinder binder;
+    status = binder.create(m_pathSnapMesh.node(),
+                           m_pathSnapMesh.inclusiveMatrix());
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
-    unsigned int numBasePoints = basePoints.length();
-    // Accelerated object for finding closest point to a mesh
-    MMeshIntersector intersector;
-    MObject oBaseMesh = m_pathBaseMesh.node();
-    // Inclusive matrix is all transforms in the path, the inverse of this
-    // matrix will transform to local space
-    intersector.create(oBaseMesh, m_pathBaseMesh.inclusiveMatrixInverse());
+    uint64_t numQueries = 0;
+    mapData.resize(basePoints.size());
+    std::vector<SurfaceBindingData *> bindings(basePoints.size());
+    for (size_t ii = 0; ii < basePoints.size(); ++ii) {
+        MFnPluginData fnBindData;
+        mapData[ii] = fnBindData.create(SurfaceBindingData::id, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        bindings[ii] =
+            static_cast<SurfaceBindingData *>(fnBindData.data(&status));
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        numQueries += basePoints[ii].length();
+    }
+
+    progress.begin(numQueries);
+    finished = true;
+    for (size_t ii = 0; ii < basePoints.size() && finished; ++ii) {
+        finished = binder.bind(basePoints[ii], *bindings[ii], &progress);
+    }
+    progress.end();
+
+    return MS::kSuccess;
+}
+
+MStatus MeshSnapCommand::calculateRbfBindings(
+    const std::vector<MPointArray> &basePoints, MappingProgress &progress,
+    std::vector<MObject> &mapData, bool &finished) {
+    MStatus status;
 
+    MString label("meshSnap rbf binding (");
+    label += (int)basePoints.size();
+    label += " meshes, ";
+    label += (int)m_neighbours;
+    label += " neighbours, ";
+    label += MThreadUtils::getNumThreads();
+    label += " threads)";
+    TIME_SCOPE(label);
 
+    // One tree over the snap mesh serves every base mesh
     MFnMesh fnSnapMesh(m_pathSnapMesh, &status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
     MPointArray snapPoints;
-    status = fnBaseMesh.getPoints(snapPoints, MSpace::kWorld);
+    status = fnSnapMesh.getPoints(snapPoints, MSpace::kWorld);
     CHECK_MSTATUS_AND_RETURN_IT(status);
+    RbfBinder binder;
+    binder.create(snapPoints, m_pathSnapMesh.inclusiveMatrixInverse());
+
+    uint64_t numQueries = 0;
+    mapData.resize(basePoints.size());
+    std::vector<RbfBindingData *> bindings(basePoints.size());
+    for (size_t ii = 0; ii < basePoints.size(); ++ii) {
+        MFnPluginData fnBindData;
+        mapData[ii] = fnBindData.create(RbfBindingData::id, &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        bindings[ii] = static_cast<RbfBindingData *>(fnBindData.data(&status));
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        numQueries += basePoints[ii].length();
+    }
 
-    MPointOnMesh meshPoint;
-
-    MIntArray vertexList;
+    progress.begin(numQueries);
+    finished = true;
+    for (size_t ii = 0; ii < basePoints.size() && finished; ++ii) {
+        finished = binder.bind(basePoints[ii], m_neighbours, *bindings[ii],
+                               &progress);
+    }
+    progress.end();
 
-    double minDistance;
-    int closestVertId, faceIndex;
-    double thisDistance;
+    return MS::kSuccess;
+}
 
-    m_vertexMapping =
-        MIntArray(numBasePoints,
-                  -1); // -1 means vertex has no corresponding vertex to map to
-    MDoubleArray distances(numBasePoints, 9999999.0);
+MStatus MeshSnapCommand::getBasePoints(std::vector<MPointArray> &basePoints) {
+    MStatus status;
 
-    for (unsigned int ii = 0; ii < snapPoints.length(); ++ii) {
-        // Get point on base mesh closest to snap mesh point
-        status = intersector.getClosestPoint(snapPoints[ii], meshPoint);
+    basePoints.resize(m_pathBaseMeshes.size());
+    for (size_t ii = 0; ii < m_pathBaseMeshes.size(); ++ii) {
+        MFnMesh fnBaseMesh(m_pathBaseMeshes[ii], &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        status = fnBaseMesh.getPoints(basePoints[ii], MSpace::kWorld);
         CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
 
-        // Get list of vertices that make up the face that the closest point
-        // rests on
-        faceIndex = meshPoint.faceIndex();
-        fnBaseMesh.getPolygonVertices(faceIndex, vertexList);
-
-        // Find the closest of the vertices
-        minDistance = 9999999.0;
-        for (unsigned int jj = 0; jj < vertexList.length(); ++jj) {
-            // Get distance from potential closest point to snap point
-            thisDistance = basePoints[vertexList[jj]].distanceTo(snapPoints[ii]);
-            if (thisDistance < minDistance) {
-                minDistance   = thisDistance;
-                closestVertId = vertexList[jj];
-            }
-            if (minDistance < 0.00001) {
-                // Vertex right on top so use it
-                break;
-            }
-        }
+    return MS::kSuccess;
+}
 
-        if (m_vertexMapping[closestVertId] != -1 &&
-            minDistance > distances[closestVertId]) {
-            // This vertex has already been assigned a closer vertex - covers
-            // the case that a given vertex is the closest to multiple potential
-            // snap points
-            continue;
-        }
+MStatus
+MeshSnapCommand::getMappingKeys(const std::vector<MPointArray> &basePoints,
+                                std::vector<uint64_t> &keys) {
+    MStatus status;
+
+    // Everything about the snap mesh is shared by every key. RBF bindings
+    // also depend on its matrix, as their offsets are in its object space.
+    MFnMesh fnSnapMesh(m_pathSnapMesh, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MPointArray snapPoints;
+    status = fnSnapMesh.getPoints(snapPoints, MSpace::kWorld);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    uint64_t snapHash;
+    status = topologyHash(fnSnapMesh, snapHash);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    snapHash = hashPoints(snapHash, snapPoints);
+    snapHash = hashMatrix(snapHash, m_pathSnapMesh.inclusiveMatrix());
+    snapHash = hashWord(snapHash, (uint32_t)m_bindMode);
+    if (m_bindMode == MeshSnap::kRbf) {
+        snapHash = hashWord(snapHash, m_neighbours);
+    }
 
-        m_vertexMapping[closestVertId] = ii;
-        distances[closestVertId]       = minDistance;
+    keys.resize(m_pathBaseMeshes.size());
+    for (size_t ii = 0; ii < m_pathBaseMeshes.size(); ++ii) {
+        MFnMesh fnBaseMesh(m_pathBaseMeshes[ii], &status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        uint64_t baseHash;
+        status = topologyHash(fnBaseMesh, baseHash);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        baseHash = hashPoints(baseHash, basePoints[ii]);
+        keys[ii] = hashWord(hashWord(snapHash, (uint32_t)baseHash),
+                            (uint32_t)(baseHash >> 32));
     }
 
     return MS::kSuccess;
 }
 
+MTypeId MeshSnapCommand::mapDataId() const {
+    switch (m_bindMode) {
+    case MeshSnap::kSurface:
+        return SurfaceBindingData::id;
+    case MeshSnap::kRbf:
+        return RbfBindingData::id;
+    default:
+        return VertexMappingData::id;
+    }
+}
+
 MStatus MeshSnapCommand::redoIt() {
     MStatus status;
 
@@ -128,19 +400,6 @@ MStatus MeshSnapCommand::redoIt() {
     status = m_dgMod.doIt();
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
-    MFnIntArrayData fnIntData;
-    MObject oData = fnIntData.create(m_vertexMapping, &status);
-    CHECK_MSTATUS_AND_RETURN_IT(status);
-
-    // Traverse dependency graph of base mesh to find snap deformer
-    MObject oSnapDeformer;
-    status = getSnapDeformerFromBaseMesh(oSnapDeformer);
-    CHECK_MSTATUS_AND_RETURN_IT(status);
-
-    // Put vertex mapping data into attribute
-    MPlug plugVertexMapping(oSnapDeformer, MeshSnap::aMapping);
-    plugVertexMapping.setMObject(oData);
-
     // Get world mesh of the snap mesh object
     MFnDagNode fnSnapMesh(m_pathSnapMesh, &status);
     CHECK_MSTATUS_AND_RETURN_IT(status);
@@ -150,11 +409,35 @@ MStatus MeshSnapCommand::redoIt() {
     status = plugWorldMesh.selectAncestorLogicalIndex(0, plugWorldMesh.attribute());
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
-    // Fill the snap mesh attribute with the snap mesh object data
-    MPlug plugSnapMesh(oSnapDeformer, MeshSnap::aSnapMesh);
     MDGModifier dgMod;
-    status = dgMod.connect(plugWorldMesh, plugSnapMesh);
-    CHECK_MSTATUS_AND_RETURN_IT(status);
+    for (size_t ii = 0; ii < m_pathBaseMeshes.size(); ++ii) {
+        // Traverse dependency graph of base mesh to find snap deformer
+        MObject oSnapDeformer;
+        status = getSnapDeformerFromBaseMesh(m_pathBaseMeshes[ii],
+                                             oSnapDeformer);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+
+        // Put vertex mapping or surface or RBF binding data into attribute
+        if (m_bindMode == MeshSnap::kSurface) {
+            MPlug plugBindMode(oSnapDeformer, MeshSnap::aBindMode);
+            plugBindMode.setInt(m_bindMode);
+            MPlug plugSurfaceBinding(oSnapDeformer, MeshSnap::aSurfaceBinding);
+            plugSurfaceBinding.setMObject(m_mapData[ii]);
+        } else if (m_bindMode == MeshSnap::kRbf) {
+            MPlug plugBindMode(oSnapDeformer, MeshSnap::aBindMode);
+            plugBindMode.setInt(m_bindMode);
+            MPlug plugRbfBinding(oSnapDeformer, MeshSnap::aRbfBinding);
+            plugRbfBinding.setMObject(m_mapData[ii]);
+        } else {
+            MPlug plugVertexMapping(oSnapDeformer, MeshSnap::aMapping);
+            plugVertexMapping.setMObject(m_mapData[ii]);
+        }
+
+        // Fill the snap mesh attribute with the snap mesh object data
+        MPlug plugSnapMesh(oSnapDeformer, MeshSnap::aSnapMesh);
+        status = dgMod.connect(plugWorldMesh, plugSnapMesh);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+    }
     status = dgMod.doIt();
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
@@ -180,9 +463,18 @@ MSyntax MeshSnapCommand::newSyntax() {
 
     // Name to give mesh snap deformer node
     syntax.addFlag("-n", "-name", MSyntax::kString);
-    // Arguments to command, in this case the mesh to snap and the mesh to snap
-    // to
-    syntax.setObjectType(MSyntax::kSelectionList, 2, 2);
+    // How the meshes are bound to the snap mesh, vertex, surface or rbf
+    syntax.addFlag("-bm", "-bindMode", MSyntax::kString);
+    // Number of snap vertices each vertex is bound to in the rbf bind mode
+    syntax.addFlag("-nb", "-neighbours", MSyntax::kLong);
+    // Distance within which vertices are matched without a full nearest
+    // vertex search, for meshes that are nearly on top of each other
+    syntax.addFlag("-tol", "-tolerance", MSyntax::kDouble);
+    // Directory to keep built mappings in, for snapping the same meshes again
+    syntax.addFlag("-cd", "-cacheDirectory", MSyntax::kString);
+    // Arguments to command, in this case the meshes to snap and the mesh to
+    // snap to
+    syntax.setObjectType(MSyntax::kSelectionList, 2);
     // Allow the user to select these arguments, rather than having to type in
     // their names
     syntax.useSelectionAsDefault(true);
@@ -232,10 +524,12 @@ MStatus MeshSnapCommand::getShapeNode(MDagPath &path) {
     return MS::kFailure;
 }
 
-MStatus MeshSnapCommand::getSnapDeformerFromBaseMesh(MObject &oSnapDeformer) {
+MStatus
+MeshSnapCommand::getSnapDeformerFromBaseMesh(const MDagPath &pathBaseMesh,
+                                             MObject &oSnapDeformer) {
     MStatus status;
 
-    MObject oBaseMesh = m_pathBaseMesh.node();
+    MObject oBaseMesh = pathBaseMesh.node();
     MItDependencyGraph itGraph(oBaseMesh, MFn::kInvalid, // No filter
                                MItDependencyGraph::kUpstream,
                                MItDependencyGraph::kDepthFirst,
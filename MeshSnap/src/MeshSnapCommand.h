@@ -1,16 +1,19 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include <maya/MArgDatabase.h>
 #include <maya/MDGModifier.h>
 #include <maya/MDagPath.h>
 #include <maya/MFnDagNode.h>
 #include <maya/MFnDependencyNode.h>
-#include <maya/MFnIntArrayData.h>
 #include <maya/MFnMesh.h>
+#include <maya/MFnPluginData.h>
 #include <maya/MGlobal.h>
+#include <maya/MDoubleArray.h>
 #include <maya/MIntArray.h>
 #include <maya/MItDependencyGraph.h>
-#include <maya/MMeshIntersector.h>
 #include <maya/MObject.h>
 #include <maya/MPlug.h>
 #include <maya/MPointArray.h>
@@ -19,9 +22,38 @@
 
 #include <maya/MPxCommand.h>
 
+#include "MappingFileCache.h"
+#include "MeshSnap.h"
+#include "VertexMapping.h"
+
+/**
+ * Snap one or more meshes to another with meshSnap deformers.
+ *
+ * Name:
+ *   meshSnap
+ *
+ * Arguments:
+ *   The meshes to snap followed by the mesh to snap to. Each mesh to snap
+ *   gets its own deformer, all of them are made by one undoable command.
+ *
+ * Flags:
+ *   -name (-n) - Name to give the deformers.
+ *   -bindMode (-bm) - vertex (the default), surface or rbf, see the
+ *   meshSnap node's bindMode.
+ *   -neighbours (-nb) - Number of snap vertices each vertex is bound to in
+ *   the rbf bind mode, 8 by default.
+ *   -tolerance (-tol) - Match vertex pairs closer than this quickly, only
+ *   searching the whole mesh for vertices with nothing this close. The
+ *   mapping is the same as without it. Vertex bind mode only.
+ *   -cacheDirectory (-cd) - Existing directory to save mappings in and load
+ *   them from when the same meshes are snapped again, in the same places.
+ *   Defaults to the MESHSNAP_CACHE_DIR environment variable, no caching if
+ *   neither is set.
+ */
 class MeshSnapCommand : public MPxCommand {
   public:
-    MeshSnapCommand(){};
+    MeshSnapCommand()
+        : m_bindMode(MeshSnap::kVertex), m_neighbours(kDefaultRbfNeighbours){};
     ~MeshSnapCommand(){};
     virtual MStatus doIt(const MArgList &argList);
     virtual MStatus redoIt();
@@ -37,14 +69,57 @@ class MeshSnapCommand : public MPxCommand {
      */
     static MStatus getShapeNode(MDagPath &path);
     /**
-     * Calculate the vertex mapping between the base mesh and the snap mesh.
+     * Calculate the vertex mapping between each of basePoints (in world
+     * space) and the snap mesh, one mapData per base mesh. Each snap mesh
+     * vertex is mapped to the base mesh vertex nearest to it, the closest
+     * snap vertex wins when several pick the same base vertex. finished is
+     * set to false if the user interrupted.
+     */
+    MStatus calculateVertexMappings(const std::vector<MPointArray> &basePoints,
+                                    double tolerance,
+                                    MappingProgress &progress,
+                                    std::vector<MObject> &mapData,
+                                    bool &finished);
+    /**
+     * Bind every one of basePoints to the closest point on the snap mesh.
+     * finished is set to false if the user interrupted.
+     */
+    MStatus calculateSurfaceBindings(const std::vector<MPointArray> &basePoints,
+                                     MappingProgress &progress,
+                                     std::vector<MObject> &mapData,
+                                     bool &finished);
+    /**
+     * Bind every one of basePoints to its nearest snap mesh vertices with
+     * RBF weights. finished is set to false if the user interrupted.
+     */
+    MStatus calculateRbfBindings(const std::vector<MPointArray> &basePoints,
+                                 MappingProgress &progress,
+                                 std::vector<MObject> &mapData,
+                                 bool &finished);
+    /**
+     * World space points of each base mesh.
+     */
+    MStatus getBasePoints(std::vector<MPointArray> &basePoints);
+    /**
+     * Key for each base mesh's mapping in the mapping file cache, from
+     * everything the mapping depends on: the bind mode and its settings and
+     * both meshes' topology and world space points.
+     */
+    MStatus getMappingKeys(const std::vector<MPointArray> &basePoints,
+                           std::vector<uint64_t> &keys);
+    /**
+     * Type of data the bind mode makes.
      */
-    MStatus calculateVertexMapping();
-    MStatus getSnapDeformerFromBaseMesh(MObject &oSnapDeformer);
+    MTypeId mapDataId() const;
+    static MStatus getSnapDeformerFromBaseMesh(const MDagPath &pathBaseMesh,
+                                               MObject &oSnapDeformer);
 
-    MDagPath m_pathBaseMesh;
+    std::vector<MDagPath> m_pathBaseMeshes;
     MDagPath m_pathSnapMesh;
-    MIntArray m_vertexMapping;
+    MeshSnap::BindMode m_bindMode;
+    unsigned int m_neighbours;
+    // Vertex mapping or surface or RBF binding data for each base mesh
+    std::vector<MObject> m_mapData;
     MString m_name;
     MDGModifier m_dgMod;
 };
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <maya/MThreadPool.h>
+#include <maya/MThreadUtils.h>
+
+namespace detail {
+
+template <typename Fn> struct ParallelForBlock {
+    const Fn *fn;
+    unsigned int begin;
+    unsigned int end;
+};
+
+template <typename Fn> MThreadRetVal parallelForTask(void *data) {
+    ParallelForBlock<Fn> *block = static_cast<ParallelForBlock<Fn> *>(data);
+    (*block->fn)(block->begin, block->end);
+    return 0;
+}
+
+template <typename Fn>
+void parallelForRegion(void *data, MThreadRootTask *root) {
+    std::vector<ParallelForBlock<Fn>> *blocks =
+        static_cast<std::vector<ParallelForBlock<Fn>> *>(data);
+    for (size_t ii = 0; ii < blocks->size(); ++ii) {
+        MThreadPool::createTask(parallelForTask<Fn>, &(*blocks)[ii], root);
+    }
+    MThreadPool::executeAndJoin(root);
+}
+
+} // namespace detail
+
+/**
+ * Split the range [0, count) into contiguous blocks and call fn(begin, end)
+ * for each of them on Maya's thread pool, returning once every block is done.
+ *
+ * Blocks are never smaller than minBlockSize, so small ranges (or a single
+ * block) are run directly on the calling thread without touching the pool.
+ */
+template <typename Fn>
+void parallelFor(unsigned int count, unsigned int minBlockSize, const Fn &fn) {
+    if (count == 0) {
+        return;
+    }
+
+    // A few blocks per thread so that uneven blocks still balance out
+    unsigned int numThreads = std::max(MThreadUtils::getNumThreads(), 1);
+    unsigned int blockSize =
+        std::max(minBlockSize, (count + numThreads * 4 - 1) / (numThreads * 4));
+    if (blockSize >= count) {
+        fn(0u, count);
+        return;
+    }
+
+    std::vector<detail::ParallelForBlock<Fn>> blocks;
+    blocks.reserve((count + blockSize - 1) / blockSize);
+    for (unsigned int begin = 0; begin < count; begin += blockSize) {
+        detail::ParallelForBlock<Fn> block = {
+            &fn, begin, std::min(begin + blockSize, count)};
+        blocks.push_back(block);
+    }
+
+    MThreadPool::init();
+    MThreadPool::newParallelRegion(detail::parallelForRegion<Fn>, &blocks);
+    MThreadPool::release();
+}
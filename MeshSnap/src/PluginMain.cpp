@@ -1,5 +1,8 @@
 #include "MeshSnap.h"
 #include "MeshSnapCommand.h"
+#include "RbfBindingData.h"
+#include "SurfaceBindingData.h"
+#include "VertexMappingData.h"
 
 #include <maya/MFnPlugin.h>
 
@@ -7,6 +10,19 @@ MStatus initializePlugin(MObject obj) {
     MStatus status;
     MFnPlugin plugin(obj, "Samuel Evans-Powell", "1.0", "Any");
 
+    // The data types have to exist before the node that uses them
+    status = plugin.registerData(VertexMappingData::typeName,
+                                 VertexMappingData::id,
+                                 VertexMappingData::creator);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    status = plugin.registerData(SurfaceBindingData::typeName,
+                                 SurfaceBindingData::id,
+                                 SurfaceBindingData::creator);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    status = plugin.registerData(RbfBindingData::typeName, RbfBindingData::id,
+                                 RbfBindingData::creator);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
     status = plugin.registerCommand("meshSnap", MeshSnapCommand::creator,
                                     MeshSnapCommand::newSyntax);
     CHECK_MSTATUS_AND_RETURN_IT(status);
@@ -28,5 +44,12 @@ MStatus uninitializePlugin(MObject obj) {
     status = plugin.deregisterNode(MeshSnap::id);
     CHECK_MSTATUS_AND_RETURN_IT(status);
 
+    status = plugin.deregisterData(RbfBindingData::id);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    status = plugin.deregisterData(SurfaceBindingData::id);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    status = plugin.deregisterData(VertexMappingData::id);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
     return status;
 }
@@ -0,0 +1,147 @@
+#include <limits>
+
+#include "RbfBindingData.h"
+
+const MTypeId RbfBindingData::id(0x0000042A);
+const MString RbfBindingData::typeName("meshSnapRbfBinding");
+
+void *RbfBindingData::creator() { return new RbfBindingData; }
+
+void RbfBindingData::resize(unsigned int numBaseVertices, unsigned int k) {
+    m_k = k;
+    m_indices.assign(numBaseVertices * k, 0);
+    m_weights.assign(numBaseVertices * k, 0.0f);
+    m_offsets.assign(numBaseVertices * 3, 0.0f);
+    for (unsigned int ii = 0; k > 0 && ii < numBaseVertices; ++ii) {
+        m_weights[ii * k] = 1.0f;
+    }
+}
+
+MStatus RbfBindingData::readASCII(const MArgList &args,
+                                  unsigned int &lastElement) {
+    MStatus status;
+
+    // <number of vertices> <k> followed by k <index> <weight> pairs and
+    // <x> <y> <z> offset for each
+    unsigned int numBaseVertices = args.asInt(lastElement++, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    unsigned int k = args.asInt(lastElement++, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    if ((k == 0 && numBaseVertices > 0) || !hasArgs(args, lastElement, k, 2) ||
+        !hasArgs(args, lastElement, numBaseVertices, 2 * k + 3)) {
+        return MS::kFailure;
+    }
+
+    resize(numBaseVertices, k);
+    for (unsigned int ii = 0; ii < numBaseVertices; ++ii) {
+        for (unsigned int jj = 0; jj < k; ++jj) {
+            m_indices[ii * k + jj] = args.asInt(lastElement++, &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+            m_weights[ii * k + jj] =
+                (float)args.asDouble(lastElement++, &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+        }
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            m_offsets[ii * 3 + axis] =
+                (float)args.asDouble(lastElement++, &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+        }
+    }
+
+    return readHashASCII(args, lastElement);
+}
+
+MStatus RbfBindingData::readBinary(std::istream &in, unsigned int length) {
+    // <uint32 number of vertices> <uint32 k> <uint32 indices...>
+    // <float weights...> <float offsets...> [<uint64 snap topology hash>]
+    uint32_t numBaseVertices = 0, k = 0;
+    in.read(reinterpret_cast<char *>(&numBaseVertices),
+            sizeof(numBaseVertices));
+    in.read(reinterpret_cast<char *>(&k), sizeof(k));
+    size_t bindingLength =
+        sizeof(numBaseVertices) + sizeof(k) +
+        (size_t)numBaseVertices *
+            (k * (sizeof(uint32_t) + sizeof(float)) + 3 * sizeof(float));
+    if (!in || (k == 0 && numBaseVertices > 0) || length < bindingLength ||
+        length > bindingLength + kHashBytes) {
+        return MS::kFailure;
+    }
+
+    resize(numBaseVertices, k);
+    if (!m_indices.empty()) {
+        in.read(reinterpret_cast<char *>(&m_indices[0]),
+                m_indices.size() * sizeof(uint32_t));
+        in.read(reinterpret_cast<char *>(&m_weights[0]),
+                m_weights.size() * sizeof(float));
+    }
+    if (!m_offsets.empty()) {
+        in.read(reinterpret_cast<char *>(&m_offsets[0]),
+                m_offsets.size() * sizeof(float));
+    }
+
+    unsigned char hashBytes[kHashBytes];
+    size_t hashLength = length - bindingLength;
+    in.read(reinterpret_cast<char *>(hashBytes), hashLength);
+    if (!in) {
+        return MS::kFailure;
+    }
+
+    return readHashBinary(hashBytes, hashLength);
+}
+
+MStatus RbfBindingData::writeASCII(std::ostream &out) {
+    // Enough digits for every float to read back exactly, the weights of
+    // nearby vertices can be large and cancel each other out
+    std::streamsize precision =
+        out.precision(std::numeric_limits<float>::max_digits10);
+
+    unsigned int numBaseVertices = this->numBaseVertices();
+    out << numBaseVertices << " " << m_k;
+    for (unsigned int ii = 0; ii < numBaseVertices; ++ii) {
+        for (unsigned int jj = 0; jj < m_k; ++jj) {
+            out << " " << m_indices[ii * m_k + jj] << " "
+                << m_weights[ii * m_k + jj];
+        }
+        out << " " << m_offsets[ii * 3] << " " << m_offsets[ii * 3 + 1] << " "
+            << m_offsets[ii * 3 + 2];
+    }
+    writeHashASCII(out);
+    out.precision(precision);
+
+    return out ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus RbfBindingData::writeBinary(std::ostream &out) {
+    uint32_t numBaseVertices = this->numBaseVertices();
+    uint32_t k               = m_k;
+    out.write(reinterpret_cast<const char *>(&numBaseVertices),
+              sizeof(numBaseVertices));
+    out.write(reinterpret_cast<const char *>(&k), sizeof(k));
+    if (!m_indices.empty()) {
+        out.write(reinterpret_cast<const char *>(&m_indices[0]),
+                  m_indices.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char *>(&m_weights[0]),
+                  m_weights.size() * sizeof(float));
+    }
+    if (!m_offsets.empty()) {
+        out.write(reinterpret_cast<const char *>(&m_offsets[0]),
+                  m_offsets.size() * sizeof(float));
+    }
+    writeHashBinary(out);
+
+    return out ? MS::kSuccess : MS::kFailure;
+}
+
+void RbfBindingData::copy(const MPxData &other) {
+    const RbfBindingData &otherData =
+        static_cast<const RbfBindingData &>(other);
+    m_k                = otherData.m_k;
+    m_indices          = otherData.m_indices;
+    m_weights          = otherData.m_weights;
+    m_offsets          = otherData.m_offsets;
+    m_snapTopologyHash = otherData.m_snapTopologyHash;
+}
+
+MTypeId RbfBindingData::typeId() const { return id; }
+
+MString RbfBindingData::name() const { return typeName; }
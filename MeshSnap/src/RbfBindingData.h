@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <maya/MArgList.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include <maya/MTypeId.h>
+
+#include "MappingData.h"
+
+/**
+ * The meshSnap RBF binding: every base vertex bound to its k nearest snap
+ * vertices with radial basis function weights, plus an offset.
+ *
+ * A base vertex follows offset + sum(weight * snap vertex) in the snap
+ * mesh's object space. The weights of each vertex add up to one, so this is
+ * the vertex's bind position plus the weighted sum of how far its neighbours
+ * have moved.
+ *
+ * Stored as a sparse matrix with k entries in every row: the snap vertices
+ * and weights of each base vertex are next to each other, k at a time.
+ *
+ * Name:
+ *   meshSnapRbfBinding
+ */
+class RbfBindingData : public MappingData {
+  public:
+    RbfBindingData() : m_k(0){};
+    virtual ~RbfBindingData(){};
+    static void *creator();
+
+    virtual MStatus readASCII(const MArgList &args,
+                              unsigned int &lastElement) override;
+    virtual MStatus readBinary(std::istream &in, unsigned int length) override;
+    virtual MStatus writeASCII(std::ostream &out) override;
+    virtual MStatus writeBinary(std::ostream &out) override;
+    virtual void copy(const MPxData &other) override;
+    virtual MTypeId typeId() const override;
+    virtual MString name() const override;
+
+    /**
+     * Make room for numBaseVertices rows of k entries. Every row starts out
+     * as snap vertex 0 with a weight of one and no offset.
+     */
+    void resize(unsigned int numBaseVertices, unsigned int k);
+
+    virtual unsigned int numBaseVertices() const override {
+        return (unsigned int)(m_offsets.size() / 3);
+    }
+    unsigned int k() const { return m_k; }
+
+    /**
+     * Snap vertices of each row, k per base vertex.
+     */
+    unsigned int *indices(unsigned int vertex) {
+        return &m_indices[vertex * m_k];
+    }
+    const unsigned int *indices(unsigned int vertex) const {
+        return &m_indices[vertex * m_k];
+    }
+    /**
+     * Weights of each row, k per base vertex.
+     */
+    float *weights(unsigned int vertex) { return &m_weights[vertex * m_k]; }
+    const float *weights(unsigned int vertex) const {
+        return &m_weights[vertex * m_k];
+    }
+    /**
+     * x, y, z offset of each base vertex.
+     */
+    float *offset(unsigned int vertex) { return &m_offsets[vertex * 3]; }
+    const float *offset(unsigned int vertex) const {
+        return &m_offsets[vertex * 3];
+    }
+
+    static const MTypeId id;
+    static const MString typeName;
+
+  private:
+    unsigned int m_k;
+    std::vector<unsigned int> m_indices;
+    std::vector<float> m_weights;
+    std::vector<float> m_offsets;
+};
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cmath>
+
+#include "SpatialHash.h"
+
+void SpatialHash::cell(const double *point, int64_t coordinates[3]) const {
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        coordinates[axis] = (int64_t)std::floor(point[axis] / m_cellSize);
+    }
+}
+
+uint32_t SpatialHash::slot(const int64_t coordinates[3]) const {
+    uint64_t hash = (uint64_t)coordinates[0] * 73856093ULL ^
+                    (uint64_t)coordinates[1] * 19349663ULL ^
+                    (uint64_t)coordinates[2] * 83492791ULL;
+    return (uint32_t)(hash ^ (hash >> 32)) & m_tableMask;
+}
+
+void SpatialHash::build(const MPointArray &points, double radius) {
+    unsigned int numPoints = points.length();
+    m_radius               = radius;
+    m_cellSize             = radius * 2.0;
+
+    uint32_t tableSize = 1;
+    while (tableSize < numPoints * 2) {
+        tableSize <<= 1;
+    }
+    m_tableMask = tableSize - 1;
+
+    // Count the points in each slot, then place them
+    std::vector<uint32_t> slots(numPoints);
+    m_slotStarts.assign(tableSize + 1, 0);
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        double point[3] = {points[ii].x, points[ii].y, points[ii].z};
+        int64_t coordinates[3];
+        cell(point, coordinates);
+        slots[ii] = slot(coordinates);
+        ++m_slotStarts[slots[ii] + 1];
+    }
+    for (uint32_t ss = 0; ss < tableSize; ++ss) {
+        m_slotStarts[ss + 1] += m_slotStarts[ss];
+    }
+
+    std::vector<uint32_t> next(m_slotStarts.begin(), m_slotStarts.end() - 1);
+    m_points.resize(numPoints * 3);
+    m_indices.resize(numPoints);
+    for (unsigned int ii = 0; ii < numPoints; ++ii) {
+        uint32_t position          = next[slots[ii]]++;
+        m_points[position * 3]     = points[ii].x;
+        m_points[position * 3 + 1] = points[ii].y;
+        m_points[position * 3 + 2] = points[ii].z;
+        m_indices[position]        = ii;
+    }
+}
+
+int SpatialHash::nearest(const MPoint &point, double &distance) const {
+    int bestIndex         = -1;
+    double bestDistanceSq = m_radius * m_radius;
+    double query[3]       = {point.x, point.y, point.z};
+    if (m_indices.empty()) {
+        distance = 0.0;
+        return -1;
+    }
+
+    // Cells are twice the radius wide, so anything within the radius is in
+    // one of the two cells along each axis that the radius around the point
+    // overlaps. Those cells can hash to the same slot, each slot is only
+    // searched once.
+    double lower[3] = {query[0] - m_radius, query[1] - m_radius,
+                       query[2] - m_radius};
+    int64_t first[3];
+    cell(lower, first);
+    uint32_t searched[8];
+    unsigned int numSearched = 0;
+    for (int dx = 0; dx <= 1; ++dx) {
+        for (int dy = 0; dy <= 1; ++dy) {
+            for (int dz = 0; dz <= 1; ++dz) {
+                int64_t coordinates[3] = {first[0] + dx, first[1] + dy,
+                                          first[2] + dz};
+                uint32_t ss = slot(coordinates);
+                if (std::find(searched, searched + numSearched, ss) !=
+                    searched + numSearched) {
+                    continue;
+                }
+                searched[numSearched++] = ss;
+
+                for (uint32_t position = m_slotStarts[ss];
+                     position < m_slotStarts[ss + 1]; ++position) {
+                    const double *candidate = &m_points[position * 3];
+                    double ox               = candidate[0] - query[0];
+                    double oy               = candidate[1] - query[1];
+                    double oz               = candidate[2] - query[2];
+                    double distanceSq       = ox * ox + oy * oy + oz * oz;
+                    int index               = m_indices[position];
+                    if (distanceSq < bestDistanceSq ||
+                        (distanceSq == bestDistanceSq &&
+                         (bestIndex < 0 || index < bestIndex))) {
+                        bestIndex      = index;
+                        bestDistanceSq = distanceSq;
+                    }
+                }
+            }
+        }
+    }
+
+    distance = bestIndex < 0 ? 0.0 : std::sqrt(bestDistanceSq);
+    return bestIndex;
+}
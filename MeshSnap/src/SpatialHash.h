@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <maya/MPoint.h>
+#include <maya/MPointArray.h>
+
+/**
+ * A uniform grid over a fixed set of points, hashed into a table about twice
+ * the size of the point count, for finding the nearest point within a fixed
+ * radius in expected constant time.
+ *
+ * Points are counting sorted by table slot, so each slot is a contiguous
+ * range of point data. Different cells can share a slot, every candidate is
+ * distance checked anyway.
+ */
+class SpatialHash {
+  public:
+    SpatialHash() : m_radius(0.0), m_cellSize(0.0), m_tableMask(0){};
+
+    /**
+     * Build the grid over the given points for finding points within radius,
+     * replacing any previous grid. radius must be greater than zero.
+     */
+    void build(const MPointArray &points, double radius);
+
+    /**
+     * Index (into the array the grid was built from) of the point nearest to
+     * the given point, if it is no further away than the radius the grid was
+     * built with, otherwise -1. Ties go to the lowest index. distance is set
+     * to the distance between the two.
+     */
+    int nearest(const MPoint &point, double &distance) const;
+
+    /**
+     * Bytes held by the grid.
+     */
+    size_t memoryUsage() const {
+        return m_slotStarts.capacity() * sizeof(uint32_t) +
+               m_points.capacity() * sizeof(double) +
+               m_indices.capacity() * sizeof(int);
+    }
+
+  private:
+    void cell(const double *point, int64_t coordinates[3]) const;
+    uint32_t slot(const int64_t coordinates[3]) const;
+
+    double m_radius;
+    double m_cellSize;
+    uint32_t m_tableMask;
+    // First position of each slot's points, with one extra at the end
+    std::vector<uint32_t> m_slotStarts;
+    // x, y, z of each point, in slot order
+    std::vector<double> m_points;
+    // Original index of each point, in slot order
+    std::vector<int> m_indices;
+};
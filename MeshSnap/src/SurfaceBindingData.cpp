@@ -0,0 +1,134 @@
+#include <limits>
+
+#include "SurfaceBindingData.h"
+
+const MTypeId SurfaceBindingData::id(0x00000429);
+const MString SurfaceBindingData::typeName("meshSnapSurfaceBinding");
+
+void *SurfaceBindingData::creator() { return new SurfaceBindingData; }
+
+void SurfaceBindingData::resize(unsigned int numBaseVertices) {
+    for (unsigned int corner = 0; corner < 3; ++corner) {
+        m_triangleVertices[corner].assign(numBaseVertices, 0);
+    }
+    m_weights[0].assign(numBaseVertices, 1.0f);
+    m_weights[1].assign(numBaseVertices, 0.0f);
+}
+
+MStatus SurfaceBindingData::readASCII(const MArgList &args,
+                                      unsigned int &lastElement) {
+    MStatus status;
+
+    // <number of vertices> followed by <a> <b> <c> <u> <v> for each
+    unsigned int numBaseVertices = args.asInt(lastElement++, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    if (!hasArgs(args, lastElement, numBaseVertices, 5)) {
+        return MS::kFailure;
+    }
+
+    resize(numBaseVertices);
+    for (unsigned int ii = 0; ii < numBaseVertices; ++ii) {
+        for (unsigned int corner = 0; corner < 3; ++corner) {
+            m_triangleVertices[corner][ii] = args.asInt(lastElement++, &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+        }
+        for (unsigned int corner = 0; corner < 2; ++corner) {
+            m_weights[corner][ii] =
+                (float)args.asDouble(lastElement++, &status);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+        }
+    }
+
+    return readHashASCII(args, lastElement);
+}
+
+MStatus SurfaceBindingData::readBinary(std::istream &in, unsigned int length) {
+    // <uint32 number of vertices> <uint32 corner a...> <uint32 corner b...>
+    // <uint32 corner c...> <float u...> <float v...>
+    // [<uint64 snap topology hash>]
+    uint32_t numBaseVertices = 0;
+    in.read(reinterpret_cast<char *>(&numBaseVertices),
+            sizeof(numBaseVertices));
+    size_t bindingLength =
+        sizeof(numBaseVertices) +
+        (size_t)numBaseVertices * (3 * sizeof(uint32_t) + 2 * sizeof(float));
+    if (!in || length < bindingLength ||
+        length > bindingLength + kHashBytes) {
+        return MS::kFailure;
+    }
+
+    resize(numBaseVertices);
+    if (numBaseVertices > 0) {
+        for (unsigned int corner = 0; corner < 3; ++corner) {
+            in.read(reinterpret_cast<char *>(&m_triangleVertices[corner][0]),
+                    numBaseVertices * sizeof(uint32_t));
+        }
+        for (unsigned int corner = 0; corner < 2; ++corner) {
+            in.read(reinterpret_cast<char *>(&m_weights[corner][0]),
+                    numBaseVertices * sizeof(float));
+        }
+    }
+
+    unsigned char hashBytes[kHashBytes];
+    size_t hashLength = length - bindingLength;
+    in.read(reinterpret_cast<char *>(hashBytes), hashLength);
+    if (!in) {
+        return MS::kFailure;
+    }
+
+    return readHashBinary(hashBytes, hashLength);
+}
+
+MStatus SurfaceBindingData::writeASCII(std::ostream &out) {
+    // Enough digits for every weight to read back exactly
+    std::streamsize precision =
+        out.precision(std::numeric_limits<float>::max_digits10);
+
+    unsigned int numBaseVertices = this->numBaseVertices();
+    out << numBaseVertices;
+    for (unsigned int ii = 0; ii < numBaseVertices; ++ii) {
+        out << " " << m_triangleVertices[0][ii] << " "
+            << m_triangleVertices[1][ii] << " " << m_triangleVertices[2][ii]
+            << " " << m_weights[0][ii] << " " << m_weights[1][ii];
+    }
+    writeHashASCII(out);
+    out.precision(precision);
+
+    return out ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus SurfaceBindingData::writeBinary(std::ostream &out) {
+    uint32_t numBaseVertices = this->numBaseVertices();
+    out.write(reinterpret_cast<const char *>(&numBaseVertices),
+              sizeof(numBaseVertices));
+    if (numBaseVertices > 0) {
+        for (unsigned int corner = 0; corner < 3; ++corner) {
+            out.write(
+                reinterpret_cast<const char *>(&m_triangleVertices[corner][0]),
+                numBaseVertices * sizeof(uint32_t));
+        }
+        for (unsigned int corner = 0; corner < 2; ++corner) {
+            out.write(reinterpret_cast<const char *>(&m_weights[corner][0]),
+                      numBaseVertices * sizeof(float));
+        }
+    }
+    writeHashBinary(out);
+
+    return out ? MS::kSuccess : MS::kFailure;
+}
+
+void SurfaceBindingData::copy(const MPxData &other) {
+    const SurfaceBindingData &otherData =
+        static_cast<const SurfaceBindingData &>(other);
+    for (unsigned int corner = 0; corner < 3; ++corner) {
+        m_triangleVertices[corner] = otherData.m_triangleVertices[corner];
+    }
+    for (unsigned int corner = 0; corner < 2; ++corner) {
+        m_weights[corner] = otherData.m_weights[corner];
+    }
+    m_snapTopologyHash = otherData.m_snapTopologyHash;
+}
+
+MTypeId SurfaceBindingData::typeId() const { return id; }
+
+MString SurfaceBindingData::name() const { return typeName; }
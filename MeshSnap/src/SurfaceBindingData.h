@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <maya/MArgList.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include <maya/MTypeId.h>
+
+#include "MappingData.h"
+
+/**
+ * The meshSnap surface binding: every base vertex bound to the closest point
+ * on the snap mesh, as the three snap vertices of the triangle that point
+ * lies on and its barycentric coordinates in that triangle.
+ *
+ * Each part of the binding is stored in its own array, indexed by base
+ * vertex. Only the first two barycentric weights are kept, the third is one
+ * minus the other two.
+ *
+ * Name:
+ *   meshSnapSurfaceBinding
+ */
+class SurfaceBindingData : public MappingData {
+  public:
+    SurfaceBindingData(){};
+    virtual ~SurfaceBindingData(){};
+    static void *creator();
+
+    virtual MStatus readASCII(const MArgList &args,
+                              unsigned int &lastElement) override;
+    virtual MStatus readBinary(std::istream &in, unsigned int length) override;
+    virtual MStatus writeASCII(std::ostream &out) override;
+    virtual MStatus writeBinary(std::ostream &out) override;
+    virtual void copy(const MPxData &other) override;
+    virtual MTypeId typeId() const override;
+    virtual MString name() const override;
+
+    /**
+     * Make room for numBaseVertices bindings.
+     */
+    void resize(unsigned int numBaseVertices);
+    /**
+     * Bind a base vertex to the point u * a + v * b + (1 - u - v) * c, where
+     * a, b and c are the snap vertices in triangle.
+     */
+    void bind(unsigned int vertex, const int triangle[3], float u, float v) {
+        for (unsigned int corner = 0; corner < 3; ++corner) {
+            m_triangleVertices[corner][vertex] = triangle[corner];
+        }
+        m_weights[0][vertex] = u;
+        m_weights[1][vertex] = v;
+    }
+
+    virtual unsigned int numBaseVertices() const override {
+        return (unsigned int)m_weights[0].size();
+    }
+    /**
+     * Snap vertex at the given corner (0, 1 or 2) of each base vertex's
+     * triangle.
+     */
+    const std::vector<unsigned int> &
+    triangleVertices(unsigned int corner) const {
+        return m_triangleVertices[corner];
+    }
+    /**
+     * Weight of the first (0) or second (1) corner for each base vertex.
+     */
+    const std::vector<float> &weights(unsigned int corner) const {
+        return m_weights[corner];
+    }
+
+    static const MTypeId id;
+    static const MString typeName;
+
+  private:
+    std::vector<unsigned int> m_triangleVertices[3];
+    std::vector<float> m_weights[2];
+};
@@ -0,0 +1,493 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <maya/MDoubleArray.h>
+#include <maya/MFnMesh.h>
+#include <maya/MPointOnMesh.h>
+#include <maya/MVector.h>
+
+#include "ParallelFor.h"
+#include "SpatialHash.h"
+#include "VertexMapping.h"
+
+// Smallest number of snap points worth handing to a worker thread
+static const unsigned int kMinBlockSize = 1024;
+// Closest point queries on the surface are slower, so blocks can be smaller
+static const unsigned int kMinBindBlockSize = 256;
+// RBF weight solves are slower still
+static const unsigned int kMinRbfBlockSize = 64;
+// Pivots smaller than this mean the neighbours are degenerate
+static const double kMinPivot = 1e-12;
+// Number of queries run between progress updates when reporting progress
+static const unsigned int kSliceSize = 65536;
+// Progress bar steps
+static const int kProgressSteps = 1000;
+
+// Run fn(begin, end) over [0, count) on the thread pool. With progress, the
+// range is run a slice at a time and progress is advanced by done(begin, end)
+// after each slice. Returns false if the user interrupted.
+template <typename Fn, typename Done>
+static bool parallelForSlices(unsigned int count, unsigned int minBlockSize,
+                              MappingProgress *progress, const Fn &fn,
+                              const Done &done) {
+    unsigned int sliceSize = progress ? kSliceSize : std::max(count, 1u);
+    for (unsigned int slice = 0; slice < count; slice += sliceSize) {
+        unsigned int sliceEnd = std::min(slice + sliceSize, count);
+        parallelFor(sliceEnd - slice, minBlockSize,
+                    [&](unsigned int begin, unsigned int end) {
+                        fn(slice + begin, slice + end);
+                    });
+        if (progress && !progress->advance(done(slice, sliceEnd))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Memory the process has resident right now, 0 if it can't be read
+static size_t residentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                              sizeof(counters))) {
+        return 0;
+    }
+    return counters.WorkingSetSize;
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                  (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+#else
+    // The second field is the number of resident pages
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) {
+        return 0;
+    }
+    unsigned long size = 0, resident = 0;
+    int numRead = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    if (numRead != 2) {
+        return 0;
+    }
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+MappingProgress::MappingProgress()
+    : m_total(0), m_done(0), m_bytes(0), m_peakBytes(0),
+      m_startResidentBytes(residentBytes()),
+      m_peakResidentBytes(m_startResidentBytes) {}
+
+void MappingProgress::sampleResident() {
+    m_peakResidentBytes = std::max(m_peakResidentBytes, residentBytes());
+}
+
+void MappingProgress::begin(uint64_t total) {
+    m_total = total;
+    m_done  = 0;
+    m_computation.beginComputation(true, true, false);
+    m_computation.setProgressRange(0, kProgressSteps);
+}
+
+bool MappingProgress::advance(uint64_t count) {
+    sampleResident();
+    m_done += count;
+    if (m_total > 0) {
+        m_computation.setProgress(
+            (int)(std::min(m_done, m_total) * kProgressSteps / m_total));
+    }
+    return !m_computation.isInterruptRequested();
+}
+
+void MappingProgress::end() {
+    sampleResident();
+    m_computation.endComputation();
+}
+
+void MappingProgress::allocate(size_t bytes) {
+    m_bytes += bytes;
+    m_peakBytes = std::max(m_peakBytes, m_bytes);
+}
+
+void MappingProgress::release(size_t bytes) {
+    m_bytes -= std::min(bytes, m_bytes);
+}
+
+// Map basePoints to the snap points. tree is built over basePoints here if
+// it hasn't been already and any query needs it. closestVertIds and
+// minDistances are scratch space, kept by the caller so several mappings can
+// share them. Returns false if the user interrupted.
+static bool mapToBase(const MPointArray &basePoints, KdTree &tree,
+                      const MPointArray &snapPoints, double tolerance,
+                      std::vector<int> &closestVertIds,
+                      std::vector<double> &minDistances,
+                      MIntArray &vertexMapping, MappingProgress *progress) {
+    unsigned int numBasePoints = basePoints.length();
+
+    // Get the base mesh vertex closest to every snap mesh point, each query is
+    // independent so they are split between threads
+    unsigned int numSnapPoints = snapPoints.length();
+    closestVertIds.assign(numSnapPoints, -1);
+    minDistances.resize(numSnapPoints);
+    size_t bytes = closestVertIds.capacity() * sizeof(int) +
+                   minDistances.capacity() * sizeof(double);
+
+    // Points that have a base point within the tolerance find it in the
+    // hash, and it's the same point the tree would find. Only those count
+    // towards progress, the rest are counted when the tree finds them.
+    SpatialHash hash;
+    if (tolerance > 0.0) {
+        hash.build(basePoints, tolerance);
+        bytes += hash.memoryUsage();
+        if (progress) {
+            progress->allocate(bytes);
+        }
+        bool finished = parallelForSlices(
+            numSnapPoints, kMinBlockSize, progress,
+            [&](unsigned int begin, unsigned int end) {
+                for (unsigned int ii = begin; ii < end; ++ii) {
+                    closestVertIds[ii] =
+                        hash.nearest(snapPoints[ii], minDistances[ii]);
+                }
+            },
+            [&](unsigned int begin, unsigned int end) {
+                return (uint64_t)std::count_if(
+                    closestVertIds.begin() + begin,
+                    closestVertIds.begin() + end,
+                    [](int closest) { return closest >= 0; });
+            });
+        if (!finished) {
+            progress->release(bytes);
+            return false;
+        }
+    } else if (progress) {
+        progress->allocate(bytes);
+    }
+
+    // Search the tree for the rest
+    std::vector<unsigned int> misses;
+    for (unsigned int ii = 0; ii < numSnapPoints; ++ii) {
+        if (closestVertIds[ii] < 0) {
+            misses.push_back(ii);
+        }
+    }
+    size_t treeBytes = 0;
+    if (!misses.empty() && tree.size() != numBasePoints) {
+        tree.build(basePoints);
+        treeBytes = tree.memoryUsage();
+    }
+    size_t missBytes = misses.capacity() * sizeof(unsigned int) + treeBytes;
+    if (progress) {
+        progress->allocate(missBytes);
+    }
+    bytes += missBytes;
+    bool finished = parallelForSlices(
+        (unsigned int)misses.size(), kMinBlockSize, progress,
+        [&](unsigned int begin, unsigned int end) {
+            for (unsigned int mm = begin; mm < end; ++mm) {
+                unsigned int ii    = misses[mm];
+                closestVertIds[ii] =
+                    tree.nearest(snapPoints[ii], minDistances[ii]);
+            }
+        },
+        [](unsigned int begin, unsigned int end) {
+            return (uint64_t)(end - begin);
+        });
+    if (!finished) {
+        progress->release(bytes);
+        return false;
+    }
+
+    double minDistance;
+    int closestVertId;
+
+    vertexMapping =
+        MIntArray(numBasePoints,
+                  -1); // -1 means vertex has no corresponding vertex to map to
+    MDoubleArray distances(numBasePoints, 9999999.0);
+    if (progress) {
+        // The mapping is kept, the rest goes when we return
+        progress->allocate(numBasePoints * (sizeof(int) + sizeof(double)));
+        progress->release(bytes + numBasePoints * sizeof(double));
+    }
+
+    // Resolve conflicts in snap vertex order on one thread, so the mapping is
+    // the same however the queries were split up
+    for (unsigned int ii = 0; ii < numSnapPoints; ++ii) {
+        closestVertId = closestVertIds[ii];
+        minDistance   = minDistances[ii];
+        if (closestVertId < 0) {
+            // Base mesh has no vertices
+            break;
+        }
+
+        if (vertexMapping[closestVertId] != -1 &&
+            minDistance > distances[closestVertId]) {
+            // This vertex has already been assigned a closer vertex - covers
+            // the case that a given vertex is the closest to multiple potential
+            // snap points
+            continue;
+        }
+
+        vertexMapping[closestVertId] = ii;
+        distances[closestVertId]     = minDistance;
+    }
+
+    return true;
+}
+
+bool calculateVertexMapping(const MPointArray &basePoints,
+                            const MPointArray &snapPoints,
+                            MIntArray &vertexMapping, double tolerance,
+                            MappingProgress *progress) {
+    // Accelerated structure for finding the closest base mesh vertex to a
+    // point, only built if the hash doesn't find them all
+    KdTree tree;
+
+    std::vector<int> closestVertIds;
+    std::vector<double> minDistances;
+    return mapToBase(basePoints, tree, snapPoints, tolerance, closestVertIds,
+                     minDistances, vertexMapping, progress);
+}
+
+bool calculateVertexMappings(const std::vector<MPointArray> &basePoints,
+                             const MPointArray &snapPoints,
+                             std::vector<MIntArray> &vertexMappings,
+                             double tolerance, MappingProgress *progress) {
+    unsigned int numMeshes = (unsigned int)basePoints.size();
+
+    // The trees don't depend on each other, build them a mesh per task. With
+    // a tolerance most meshes shouldn't need one.
+    std::vector<KdTree> trees(numMeshes);
+    size_t treeBytes = 0;
+    if (tolerance <= 0.0) {
+        parallelFor(numMeshes, 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int ii = begin; ii < end; ++ii) {
+                trees[ii].build(basePoints[ii]);
+            }
+        });
+        for (unsigned int ii = 0; ii < numMeshes; ++ii) {
+            treeBytes += trees[ii].memoryUsage();
+        }
+        if (progress) {
+            progress->allocate(treeBytes);
+        }
+    }
+
+    // The queries are already spread over the threads, so the meshes are
+    // mapped one after another with the same scratch space
+    vertexMappings.resize(numMeshes);
+    std::vector<int> closestVertIds;
+    std::vector<double> minDistances;
+    bool finished = true;
+    for (unsigned int ii = 0; ii < numMeshes && finished; ++ii) {
+        finished = mapToBase(basePoints[ii], trees[ii], snapPoints, tolerance,
+                             closestVertIds, minDistances, vertexMappings[ii],
+                             progress);
+    }
+
+    if (progress) {
+        progress->release(treeBytes);
+    }
+    return finished;
+}
+
+MStatus SurfaceBinder::create(const MObject &oSnapMesh,
+                              const MMatrix &snapMatrix) {
+    MStatus status;
+
+    MObject oMesh = oSnapMesh;
+    status        = m_intersector.create(oMesh, snapMatrix);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    // Look up triangle vertices ourselves, MFnMesh can't be shared between
+    // threads
+    MFnMesh fnSnapMesh(oMesh, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MIntArray triangleCounts;
+    status = fnSnapMesh.getTriangles(triangleCounts, m_triangleVertices);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    m_faceTriangles.resize(triangleCounts.length());
+    int numTriangles = 0;
+    for (unsigned int ii = 0; ii < triangleCounts.length(); ++ii) {
+        m_faceTriangles[ii] = numTriangles;
+        numTriangles += triangleCounts[ii];
+    }
+
+    return MS::kSuccess;
+}
+
+bool SurfaceBinder::bind(const MPointArray &basePoints,
+                         SurfaceBindingData &binding,
+                         MappingProgress *progress) const {
+    unsigned int numBasePoints = basePoints.length();
+    binding.resize(numBasePoints);
+    if (progress) {
+        progress->allocate(numBasePoints *
+                           (3 * sizeof(unsigned int) + 2 * sizeof(float)));
+    }
+    if (m_triangleVertices.length() == 0) {
+        // Nothing to bind to, leave every point bound to snap vertex 0
+        return progress ? progress->advance(numBasePoints) : true;
+    }
+
+    auto bindRange = [&](unsigned int begin, unsigned int end) {
+        for (unsigned int ii = begin; ii < end; ++ii) {
+            MPoint point = basePoints[ii];
+            MPointOnMesh pointOnMesh;
+            if (!m_intersector.getClosestPoint(point, pointOnMesh)) {
+                continue;
+            }
+
+            // Weights are for the triangle's vertices in the order MFnMesh
+            // gives them
+            int triangle = m_faceTriangles[pointOnMesh.faceIndex()] +
+                           pointOnMesh.triangleIndex();
+            int vertices[3] = {m_triangleVertices[triangle * 3],
+                               m_triangleVertices[triangle * 3 + 1],
+                               m_triangleVertices[triangle * 3 + 2]};
+            float u, v;
+            pointOnMesh.getBarycentricCoords(u, v);
+            binding.bind(ii, vertices, u, v);
+        }
+    };
+    return parallelForSlices(numBasePoints, kMinBindBlockSize, progress,
+                             bindRange,
+                             [](unsigned int begin, unsigned int end) {
+                                 return (uint64_t)(end - begin);
+                             });
+}
+
+// Solve the n by n system a * x = b in place by Gaussian elimination with
+// partial pivoting, leaving x in b. Returns false if a is singular.
+static bool solve(double a[][kMaxRbfNeighbours + 1], double *b,
+                  unsigned int n) {
+    for (unsigned int column = 0; column < n; ++column) {
+        unsigned int pivot = column;
+        for (unsigned int row = column + 1; row < n; ++row) {
+            if (std::fabs(a[row][column]) > std::fabs(a[pivot][column])) {
+                pivot = row;
+            }
+        }
+        if (std::fabs(a[pivot][column]) < kMinPivot) {
+            return false;
+        }
+        if (pivot != column) {
+            for (unsigned int jj = column; jj < n; ++jj) {
+                std::swap(a[pivot][jj], a[column][jj]);
+            }
+            std::swap(b[pivot], b[column]);
+        }
+
+        for (unsigned int row = column + 1; row < n; ++row) {
+            double factor = a[row][column] / a[column][column];
+            for (unsigned int jj = column; jj < n; ++jj) {
+                a[row][jj] -= factor * a[column][jj];
+            }
+            b[row] -= factor * b[column];
+        }
+    }
+
+    for (unsigned int row = n; row-- > 0;) {
+        for (unsigned int jj = row + 1; jj < n; ++jj) {
+            b[row] -= a[row][jj] * b[jj];
+        }
+        b[row] /= a[row][row];
+    }
+    return true;
+}
+
+void RbfBinder::create(const MPointArray &snapPoints,
+                       const MMatrix &worldToSnap) {
+    m_snapPoints  = snapPoints;
+    m_worldToSnap = worldToSnap;
+    m_tree.build(snapPoints);
+}
+
+bool RbfBinder::bind(const MPointArray &basePoints, unsigned int k,
+                     RbfBindingData &binding,
+                     MappingProgress *progress) const {
+    k = std::max(1u, std::min(k, kMaxRbfNeighbours));
+    unsigned int numBasePoints = basePoints.length();
+    binding.resize(numBasePoints, k);
+    if (progress) {
+        progress->allocate(numBasePoints * (k * (sizeof(unsigned int) +
+                                                 sizeof(float)) +
+                                            3 * sizeof(float)));
+    }
+
+    auto bindRange = [&](unsigned int begin, unsigned int end) {
+        int neighbours[kMaxRbfNeighbours];
+        double distances[kMaxRbfNeighbours];
+        double a[kMaxRbfNeighbours + 1][kMaxRbfNeighbours + 1];
+        double weights[kMaxRbfNeighbours + 1];
+
+        for (unsigned int ii = begin; ii < end; ++ii) {
+            const MPoint &point = basePoints[ii];
+            unsigned int n =
+                m_tree.nearest(point, k, neighbours, distances);
+            if (n == 0) {
+                continue;
+            }
+
+            // phi(|si - sj|) with a row and column of ones for the constant
+            // term, against phi(|p - si|) and one
+            for (unsigned int row = 0; row < n; ++row) {
+                const MPoint &snap = m_snapPoints[neighbours[row]];
+                for (unsigned int column = 0; column < n; ++column) {
+                    a[row][column] =
+                        snap.distanceTo(m_snapPoints[neighbours[column]]);
+                }
+                a[row][n] = 1.0;
+                a[n][row] = 1.0;
+                weights[row] = distances[row];
+            }
+            a[n][n]    = 0.0;
+            weights[n] = 1.0;
+            if (!solve(a, weights, n + 1)) {
+                // Neighbours on top of each other, follow the nearest
+                for (unsigned int row = 0; row < n; ++row) {
+                    weights[row] = row == 0 ? 1.0 : 0.0;
+                }
+            }
+
+            // Whatever the weighted neighbours don't account for is kept as
+            // an offset in the snap mesh's object space
+            unsigned int *rowIndices = binding.indices(ii);
+            float *rowWeights        = binding.weights(ii);
+            MVector offset(point);
+            for (unsigned int row = 0; row < n; ++row) {
+                const MPoint &snap = m_snapPoints[neighbours[row]];
+                rowIndices[row]    = neighbours[row];
+                rowWeights[row]    = (float)weights[row];
+                offset = offset - MVector(snap) * weights[row];
+            }
+            offset = offset * m_worldToSnap;
+            float *rowOffset = binding.offset(ii);
+            rowOffset[0]     = (float)offset.x;
+            rowOffset[1]     = (float)offset.y;
+            rowOffset[2]     = (float)offset.z;
+        }
+    };
+    return parallelForSlices(numBasePoints, kMinRbfBlockSize, progress,
+                             bindRange,
+                             [](unsigned int begin, unsigned int end) {
+                                 return (uint64_t)(end - begin);
+                             });
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <maya/MComputation.h>
+#include <maya/MIntArray.h>
+#include <maya/MMatrix.h>
+#include <maya/MMeshIntersector.h>
+#include <maya/MObject.h>
+#include <maya/MPointArray.h>
+#include <maya/MStatus.h>
+
+#include "KdTree.h"
+#include "RbfBindingData.h"
+#include "SurfaceBindingData.h"
+
+// Number of snap vertices each base vertex is bound to by default in the RBF
+// bind mode, and the most it can be bound to
+static const unsigned int kDefaultRbfNeighbours = 8;
+static const unsigned int kMaxRbfNeighbours     = 32;
+
+/**
+ * Reports how far through building mappings we are with Maya's progress bar,
+ * lets the user interrupt, and keeps track of how much memory the mapping
+ * structures take up.
+ *
+ * Progress is counted in queries, one per snap point per mapping for vertex
+ * mappings and one per base point for surface bindings. Only used from the
+ * main thread.
+ */
+class MappingProgress {
+  public:
+    /**
+     * Starts measuring the process's resident memory.
+     */
+    MappingProgress();
+
+    /**
+     * Show an interruptible progress bar for total queries.
+     */
+    void begin(uint64_t total);
+    /**
+     * Count another count queries as done. Returns false if the user asked
+     * to interrupt, in which case the work should stop.
+     */
+    bool advance(uint64_t count);
+    /**
+     * Take the progress bar down.
+     */
+    void end();
+
+    void allocate(size_t bytes);
+    void release(size_t bytes);
+    /**
+     * Estimate of the most bytes held at once by the nearest point
+     * structures, scratch space and results the mapping code allocates
+     * itself. The input point arrays, MMeshIntersector and other memory Maya
+     * allocates for us aren't included.
+     */
+    size_t peakBytes() const { return m_peakBytes; }
+    /**
+     * Most the process's resident memory grew by, over what it was when the
+     * progress was created. Sampled each time queries are counted and at the
+     * end, so it includes MMeshIntersector and everything else Maya
+     * allocates, but may miss short spikes between samples.
+     */
+    size_t peakResidentGrowth() const {
+        return m_peakResidentBytes - m_startResidentBytes;
+    }
+
+  private:
+    MComputation m_computation;
+    uint64_t m_total;
+    uint64_t m_done;
+    size_t m_bytes;
+    size_t m_peakBytes;
+    size_t m_startResidentBytes;
+    size_t m_peakResidentBytes;
+
+    void sampleResident();
+};
+
+/**
+ * Work out which snap point each base point should snap to. Every snap point
+ * picks the base point nearest to it and, when several pick the same base
+ * point, the closest of them wins. Base points that no snap point picked are
+ * mapped to -1.
+ *
+ * Both sets of points must be in the same space. The nearest point queries
+ * run on Maya's thread pool, the result doesn't depend on the number of
+ * threads.
+ *
+ * When tolerance is greater than zero, snap points first look for a base
+ * point within that distance in a spatial hash, which is much quicker than
+ * the full search for nearly coincident meshes. Only points with nothing
+ * that close fall back to the full search. The mapping is the same either
+ * way.
+ *
+ * Given progress, the queries are run in slices with progress advanced
+ * after each, and false is returned if the user interrupted.
+ */
+bool calculateVertexMapping(const MPointArray &basePoints,
+                            const MPointArray &snapPoints,
+                            MIntArray &vertexMapping, double tolerance = 0.0,
+                            MappingProgress *progress = NULL);
+
+/**
+ * Work out the mapping of each of several sets of base points to the same
+ * snap points, as calculateVertexMapping would one at a time. Without a
+ * tolerance the nearest point structures for every set are built in parallel
+ * up front.
+ */
+bool calculateVertexMappings(const std::vector<MPointArray> &basePoints,
+                             const MPointArray &snapPoints,
+                             std::vector<MIntArray> &vertexMappings,
+                             double tolerance = 0.0,
+                             MappingProgress *progress = NULL);
+
+/**
+ * Binds points to the closest point on a snap mesh's surface. Made once per
+ * snap mesh and shared by every set of points bound to it.
+ */
+class SurfaceBinder {
+  public:
+    SurfaceBinder(){};
+
+    /**
+     * Prepare to bind to the given mesh (shape or mesh data), transformed by
+     * snapMatrix.
+     */
+    MStatus create(const MObject &oSnapMesh, const MMatrix &snapMatrix);
+
+    /**
+     * Bind each of basePoints, which must be in the same space as the snap
+     * mesh after snapMatrix, to its closest point. The queries run on Maya's
+     * thread pool. Returns false if the user interrupted through progress.
+     */
+    bool bind(const MPointArray &basePoints, SurfaceBindingData &binding,
+              MappingProgress *progress = NULL) const;
+
+  private:
+    MMeshIntersector m_intersector;
+    // Index of the first triangle of each face into m_triangleVertices / 3
+    std::vector<int> m_faceTriangles;
+    // Three snap vertices per triangle, face by face
+    MIntArray m_triangleVertices;
+};
+
+/**
+ * Binds points to their nearest snap mesh vertices with radial basis function
+ * weights. Made once per snap mesh and shared by every set of points bound to
+ * it.
+ *
+ * The weights interpolate the movement of the neighbours with the linear
+ * kernel phi(r) = r and a constant term, which makes them add up to one and
+ * gives a point sitting on a snap vertex all of that vertex's movement.
+ */
+class RbfBinder {
+  public:
+    RbfBinder(){};
+
+    /**
+     * Prepare to bind to the given snap mesh points, in world space.
+     * worldToSnap takes world space to the snap mesh's object space, which
+     * the binding offsets are stored in.
+     */
+    void create(const MPointArray &snapPoints, const MMatrix &worldToSnap);
+
+    /**
+     * Bind each of basePoints, in world space, to its k nearest snap points
+     * (at most kMaxRbfNeighbours). The queries and weight solves run on
+     * Maya's thread pool. Returns false if the user interrupted through
+     * progress.
+     */
+    bool bind(const MPointArray &basePoints, unsigned int k,
+              RbfBindingData &binding,
+              MappingProgress *progress = NULL) const;
+
+  private:
+    KdTree m_tree;
+    MPointArray m_snapPoints;
+    MMatrix m_worldToSnap;
+};
@@ -0,0 +1,194 @@
+#include "VertexMappingData.h"
+
+const MTypeId VertexMappingData::id(0x00000428);
+const MString VertexMappingData::typeName("meshSnapMapping");
+
+// Zigzag encoding keeps small negative differences small
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+void *VertexMappingData::creator() { return new VertexMappingData; }
+
+void VertexMappingData::set(const MIntArray &vertexMapping) {
+    m_numBaseVertices = vertexMapping.length();
+    m_vertices.clear();
+    m_snapIndices.clear();
+    for (unsigned int ii = 0; ii < m_numBaseVertices; ++ii) {
+        if (vertexMapping[ii] != -1) {
+            m_vertices.push_back(ii);
+            m_snapIndices.push_back(vertexMapping[ii]);
+        }
+    }
+}
+
+void VertexMappingData::encode(std::vector<uint32_t> &words) const {
+    words.clear();
+    words.push_back(m_numBaseVertices);
+    words.push_back(0); // Number of segments, filled in at the end
+
+    uint32_t numSegments = 0;
+    unsigned int next    = 0; // First vertex not yet written
+    int32_t previous     = 0;
+    size_t ii            = 0;
+    while (ii < m_vertices.size()) {
+        // Run of consecutive mapped vertices starting at ii
+        size_t end = ii + 1;
+        while (end < m_vertices.size() &&
+               m_vertices[end] == m_vertices[end - 1] + 1) {
+            ++end;
+        }
+
+        words.push_back(m_vertices[ii] - next);
+        words.push_back((uint32_t)(end - ii));
+        for (size_t kk = ii; kk < end; ++kk) {
+            int32_t snapIndex = (int32_t)m_snapIndices[kk];
+            words.push_back(zigzag(snapIndex - previous));
+            previous = snapIndex;
+        }
+
+        next = m_vertices[end - 1] + 1;
+        ii   = end;
+        ++numSegments;
+    }
+
+    words[1] = numSegments;
+}
+
+template <typename Next> bool VertexMappingData::decode(Next next) {
+    uint32_t numBaseVertices, numSegments;
+    if (!next(numBaseVertices) || !next(numSegments)) {
+        return false;
+    }
+
+    m_numBaseVertices = numBaseVertices;
+    m_vertices.clear();
+    m_snapIndices.clear();
+
+    uint64_t vertex  = 0;
+    int64_t previous = 0;
+    for (uint32_t ss = 0; ss < numSegments; ++ss) {
+        uint32_t numUnmapped, numMapped;
+        if (!next(numUnmapped) || !next(numMapped)) {
+            return false;
+        }
+        vertex += numUnmapped;
+        if (vertex + numMapped > numBaseVertices) {
+            return false;
+        }
+
+        for (uint32_t kk = 0; kk < numMapped; ++kk, ++vertex) {
+            uint32_t difference;
+            if (!next(difference)) {
+                return false;
+            }
+            previous += unzigzag(difference);
+            if (previous < 0) {
+                return false;
+            }
+            m_vertices.push_back((unsigned int)vertex);
+            m_snapIndices.push_back((unsigned int)previous);
+        }
+    }
+
+    return true;
+}
+
+MStatus VertexMappingData::readASCII(const MArgList &args,
+                                     unsigned int &lastElement) {
+    MStatus status;
+
+    bool valid = decode([&](uint32_t &value) {
+        value = (uint32_t)args.asInt(lastElement++, &status);
+        return (bool)status;
+    });
+    if (!valid) {
+        return MS::kFailure;
+    }
+
+    return readHashASCII(args, lastElement);
+}
+
+MStatus VertexMappingData::readBinary(std::istream &in, unsigned int length) {
+    std::vector<unsigned char> bytes(length);
+    if (length > 0) {
+        in.read(reinterpret_cast<char *>(&bytes[0]), length);
+    }
+    if (!in) {
+        return MS::kFailure;
+    }
+
+    // Little-endian base 128 varints
+    size_t position = 0;
+    bool valid      = decode([&](uint32_t &value) {
+        value = 0;
+        for (unsigned int shift = 0; shift < 35; shift += 7) {
+            if (position >= bytes.size()) {
+                return false;
+            }
+            unsigned char byte = bytes[position++];
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    });
+
+    if (!valid) {
+        return MS::kFailure;
+    }
+
+    // The hash follows the varints
+    return readHashBinary(bytes.data() + position, bytes.size() - position);
+}
+
+MStatus VertexMappingData::writeASCII(std::ostream &out) {
+    std::vector<uint32_t> words;
+    encode(words);
+    for (size_t ii = 0; ii < words.size(); ++ii) {
+        out << (ii > 0 ? " " : "") << words[ii];
+    }
+    writeHashASCII(out);
+
+    return out ? MS::kSuccess : MS::kFailure;
+}
+
+MStatus VertexMappingData::writeBinary(std::ostream &out) {
+    std::vector<uint32_t> words;
+    encode(words);
+
+    std::vector<unsigned char> bytes;
+    bytes.reserve(words.size());
+    for (size_t ii = 0; ii < words.size(); ++ii) {
+        uint32_t value = words[ii];
+        while (value >= 0x80) {
+            bytes.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back((unsigned char)value);
+    }
+    if (!bytes.empty()) {
+        out.write(reinterpret_cast<const char *>(&bytes[0]), bytes.size());
+    }
+    writeHashBinary(out);
+
+    return out ? MS::kSuccess : MS::kFailure;
+}
+
+void VertexMappingData::copy(const MPxData &other) {
+    const VertexMappingData &otherData =
+        static_cast<const VertexMappingData &>(other);
+    m_numBaseVertices  = otherData.m_numBaseVertices;
+    m_vertices         = otherData.m_vertices;
+    m_snapIndices      = otherData.m_snapIndices;
+    m_snapTopologyHash = otherData.m_snapTopologyHash;
+}
+
+MTypeId VertexMappingData::typeId() const { return id; }
+
+MString VertexMappingData::name() const { return typeName; }
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <maya/MArgList.h>
+#include <maya/MIntArray.h>
+#include <maya/MStatus.h>
+#include <maya/MString.h>
+#include <maya/MTypeId.h>
+
+#include "MappingData.h"
+
+/**
+ * The meshSnap vertex mapping, stored as just the base vertices that are
+ * mapped and the snap vertex each maps to.
+ *
+ * In files the mapping is written as segments: a run of unmapped vertices,
+ * then a run of mapped vertices whose snap indices are each stored as the
+ * (zigzag encoded) difference from the one before. Meshes that were snapped
+ * to similar meshes mostly have differences of 1, so long runs cost a byte
+ * (binary, as varints) or two characters (ASCII) per vertex instead of a full
+ * integer, and unmapped runs cost next to nothing. The snap topology hash
+ * follows the segments.
+ *
+ * Name:
+ *   meshSnapMapping
+ */
+class VertexMappingData : public MappingData {
+  public:
+    VertexMappingData() : m_numBaseVertices(0){};
+    virtual ~VertexMappingData(){};
+    static void *creator();
+
+    virtual MStatus readASCII(const MArgList &args,
+                              unsigned int &lastElement) override;
+    virtual MStatus readBinary(std::istream &in, unsigned int length) override;
+    virtual MStatus writeASCII(std::ostream &out) override;
+    virtual MStatus writeBinary(std::ostream &out) override;
+    virtual void copy(const MPxData &other) override;
+    virtual MTypeId typeId() const override;
+    virtual MString name() const override;
+
+    /**
+     * Store a mapping with one entry per base vertex, -1 for vertices that
+     * aren't mapped.
+     */
+    void set(const MIntArray &vertexMapping);
+
+    virtual unsigned int numBaseVertices() const override {
+        return m_numBaseVertices;
+    }
+    /**
+     * Mapped base vertices, ascending.
+     */
+    const std::vector<unsigned int> &vertices() const { return m_vertices; }
+    /**
+     * Snap vertex of each mapped base vertex.
+     */
+    const std::vector<unsigned int> &snapIndices() const {
+        return m_snapIndices;
+    }
+
+    static const MTypeId id;
+    static const MString typeName;
+
+  private:
+    /**
+     * The mapping as the sequence of numbers written to file: the number of
+     * base vertices, the number of segments, then for each segment the
+     * number of unmapped vertices, the number of mapped vertices and their
+     * encoded snap index differences.
+     */
+    void encode(std::vector<uint32_t> &words) const;
+    /**
+     * Rebuild the mapping from the numbers produced by encode, read one at a
+     * time by next. Returns false if they don't describe a valid mapping.
+     */
+    template <typename Next> bool decode(Next next);
+
+    unsigned int m_numBaseVertices;
+    std::vector<unsigned int> m_vertices;
+    std::vector<unsigned int> m_snapIndices;
+};
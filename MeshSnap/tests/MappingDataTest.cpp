@@ -0,0 +1,133 @@
+// Checks that the mapping data types read back exactly what they wrote, in
+// both the ASCII (.ma) and binary (.mb) forms, and that corrupt counts in
+// the ASCII form are rejected before anything is allocated for them.
+// Returns non-zero on failure.
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include <maya/MArgList.h>
+#include <maya/MString.h>
+
+#include "../src/RbfBindingData.h"
+#include "../src/SurfaceBindingData.h"
+
+namespace {
+
+int s_failures = 0;
+
+void check(bool passed, const char *what) {
+    std::printf("%s: %s\n", what, passed ? "passed" : "FAILED");
+    s_failures += passed ? 0 : 1;
+}
+
+float randomFloat(float low, float high) {
+    return low + (high - low) * (float(std::rand()) / float(RAND_MAX));
+}
+
+// Split an ASCII form into arguments the way a scene file is read
+MArgList toArgs(const std::string &ascii) {
+    MArgList args;
+    std::istringstream in(ascii);
+    std::string token;
+    while (in >> token) {
+        args.addArg(MString(token.c_str()));
+    }
+    return args;
+}
+
+// The binary form holds every value exactly, so two data objects are equal
+// when their binary forms are
+std::string binaryForm(MPxData &data) {
+    std::ostringstream out;
+    data.writeBinary(out);
+    return out.str();
+}
+
+template <typename Data> bool asciiRoundTrip(Data &data) {
+    std::ostringstream out;
+    if (!data.writeASCII(out)) {
+        return false;
+    }
+    MArgList args = toArgs(out.str());
+    Data readBack;
+    unsigned int lastElement = 0;
+    return readBack.readASCII(args, lastElement) &&
+           lastElement == args.length() &&
+           binaryForm(readBack) == binaryForm(data);
+}
+
+template <typename Data> bool binaryRoundTrip(Data &data) {
+    std::string binary = binaryForm(data);
+    std::istringstream in(binary);
+    Data readBack;
+    return readBack.readBinary(in, (unsigned int)binary.size()) &&
+           binaryForm(readBack) == binary;
+}
+
+template <typename Data> bool rejectsASCII(const char *ascii) {
+    MArgList args = toArgs(ascii);
+    Data readBack;
+    unsigned int lastElement = 0;
+    return !readBack.readASCII(args, lastElement);
+}
+
+void testRbfBinding() {
+    // Linear RBF weights are often large with opposite signs that cancel
+    const unsigned int numBaseVertices = 500, k = 4;
+    RbfBindingData data;
+    data.resize(numBaseVertices, k);
+    for (unsigned int ii = 0; ii < numBaseVertices; ++ii) {
+        float sum = 0.0f;
+        for (unsigned int jj = 0; jj < k; ++jj) {
+            data.indices(ii)[jj] = std::rand() % 10000;
+            data.weights(ii)[jj] = randomFloat(-5000.0f, 5000.0f);
+            sum += data.weights(ii)[jj];
+        }
+        data.weights(ii)[0] += 1.0f - sum;
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            data.offset(ii)[axis] = randomFloat(-1e-3f, 1e-3f);
+        }
+    }
+    data.setSnapTopologyHash(0xF123456789ABCDEFULL);
+
+    check(asciiRoundTrip(data), "rbf ascii round trip");
+    check(binaryRoundTrip(data), "rbf binary round trip");
+    check(rejectsASCII<RbfBindingData>("-1 4"), "rbf negative count");
+    check(rejectsASCII<RbfBindingData>("1000000000 4 1 0.5"),
+          "rbf count past the end");
+    check(rejectsASCII<RbfBindingData>("1 -1"), "rbf negative k");
+}
+
+void testSurfaceBinding() {
+    const unsigned int numBaseVertices = 500;
+    SurfaceBindingData data;
+    data.resize(numBaseVertices);
+    for (unsigned int ii = 0; ii < numBaseVertices; ++ii) {
+        int triangle[3] = {std::rand() % 10000, std::rand() % 10000,
+                           std::rand() % 10000};
+        float u         = randomFloat(0.0f, 1.0f);
+        float v         = randomFloat(0.0f, 1.0f - u);
+        data.bind(ii, triangle, u, v);
+    }
+    data.setSnapTopologyHash(0xF123456789ABCDEFULL);
+
+    check(asciiRoundTrip(data), "surface ascii round trip");
+    check(binaryRoundTrip(data), "surface binary round trip");
+    check(rejectsASCII<SurfaceBindingData>("-1"), "surface negative count");
+    check(rejectsASCII<SurfaceBindingData>("1000000000 1 2 3 0.5 0.25"),
+          "surface count past the end");
+}
+
+} // namespace
+
+int main() {
+    std::srand(1);
+
+    testRbfBinding();
+    testSurfaceBinding();
+
+    return s_failures == 0 ? 0 : 1;
+}
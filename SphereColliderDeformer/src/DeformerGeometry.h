@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+
+#include <maya/MArrayDataHandle.h>
+#include <maya/MDagPath.h>
+#include <maya/MDataBlock.h>
+#include <maya/MDataHandle.h>
+#include <maya/MMatrix.h>
+#include <maya/MPlug.h>
+#include <maya/MStatus.h>
+
+#include <maya/MFnGeometryFilter.h>
+
+#include <maya/MPxDeformerNode.h>
+
+/**
+ * One geometry connected to a deformer.
+ *
+ * MPxDeformerNode::compute calls deform() for one geometry index at a time.
+ * Deformers that want to work on all of their geometry at once override
+ * compute instead, gather every geometry with gatherGeometries, deform them
+ * however they like and finish with setGeometriesClean.
+ */
+struct DeformerGeometry {
+    DeformerGeometry() : geomIndex(0), groupId(0){};
+
+    unsigned int geomIndex;
+    // Component group of the geometry the deformer affects, for MItGeometry
+    unsigned int groupId;
+    MDataHandle hInputGeom;
+    // Holds a copy of the input geometry, ready to be deformed in place
+    MDataHandle hOutputGeom;
+    MMatrix localToWorldMatrix;
+};
+
+/**
+ * Whether compute was asked for the deformed geometry, rather than something
+ * MPxDeformerNode should handle, and the node is in its normal state.
+ */
+inline bool isDeformerOutput(const MPlug &plug, MDataBlock &data) {
+    return plug.attribute() == MPxDeformerNode::outputGeom &&
+           data.inputValue(MPxDeformerNode::state).asShort() == 0;
+}
+
+/**
+ * Copy the input of every connected geometry to its output, as
+ * MPxDeformerNode would before calling deform(). Must be called from
+ * compute, on the thread that owns the data block.
+ */
+inline MStatus gatherGeometries(const MObject &node, MDataBlock &data,
+                                std::vector<DeformerGeometry> &geometries) {
+    MStatus status;
+
+    geometries.clear();
+
+    MArrayDataHandle hInput =
+        data.inputArrayValue(MPxDeformerNode::input, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MArrayDataHandle hOutput =
+        data.outputArrayValue(MPxDeformerNode::outputGeom, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    MFnGeometryFilter fnDeformer(node, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    unsigned int numInputs = hInput.elementCount();
+    for (unsigned int ii = 0; ii < numInputs; ++ii, hInput.next()) {
+        DeformerGeometry geometry;
+        geometry.geomIndex = hInput.elementIndex();
+
+        // Nothing is asking for outputs that aren't connected
+        if (!hOutput.jumpToElement(geometry.geomIndex)) {
+            continue;
+        }
+
+        MDataHandle hInputElement = hInput.inputValue(&status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        geometry.hInputGeom = hInputElement.child(MPxDeformerNode::inputGeom);
+        geometry.groupId =
+            hInputElement.child(MPxDeformerNode::groupId).asLong();
+        geometry.hOutputGeom = hOutput.outputValue(&status);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        geometry.hOutputGeom.copy(geometry.hInputGeom);
+
+        MDagPath path;
+        if (fnDeformer.getPathAtIndex(geometry.geomIndex, path)) {
+            geometry.localToWorldMatrix = path.inclusiveMatrix();
+        }
+
+        geometries.push_back(geometry);
+    }
+
+    return MS::kSuccess;
+}
+
+/**
+ * Mark every output as computed.
+ */
+inline MStatus setGeometriesClean(MDataBlock &data,
+                                  std::vector<DeformerGeometry> &geometries) {
+    MStatus status;
+
+    for (size_t ii = 0; ii < geometries.size(); ++ii) {
+        geometries[ii].hOutputGeom.setClean();
+    }
+
+    MArrayDataHandle hOutput =
+        data.outputArrayValue(MPxDeformerNode::outputGeom, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    return hOutput.setAllClean();
+}
@@ -1,9 +1,21 @@
 #include <maya/MFnPlugin.h>
 
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "ParallelFor.h"
 #include "SphereColliderDeformer.h"
 
+// Smallest number of points worth handing to a worker thread
+static const unsigned int kMinBlockSize = 4096;
+// Number of points staged into float streams at a time
+static const unsigned int kChunkSize = 256;
+
 MTypeId SphereColliderDeformer::id(0x00000424);
 MObject SphereColliderDeformer::aCollideMatrix;
+MObject SphereColliderDeformer::aCollideMatrices;
 
 void *SphereColliderDeformer::creator() { return new SphereColliderDeformer; }
 
@@ -16,49 +28,275 @@ MStatus SphereColliderDeformer::initialize() {
     addAttribute(aCollideMatrix);
     attributeAffects(aCollideMatrix, outputGeom);
 
+    aCollideMatrices = matrixAttribute.create("collideMatrices", "cms");
+    matrixAttribute.setArray(true);
+    addAttribute(aCollideMatrices);
+    attributeAffects(aCollideMatrices, outputGeom);
+
     return MS::kSuccess;
 }
 
-MStatus SphereColliderDeformer::deform(MDataBlock &data, MItGeometry &itGeo,
-                                       const MMatrix &localToWorldMatrix,
-                                       unsigned int geomIndex) {
+namespace {
+
+// What colliding one geometry needs. The iterator is only used on the main
+// thread, the collision only touches the points and matrices.
+struct CollideGeometry {
+    std::unique_ptr<MItGeometry> itGeo;
+    MPointArray points;
+    // Takes points from local space into the space they are collided in,
+    // and back
+    float toCollider[4][3];
+    float toLocal[4][3];
+};
+
+// A block of one geometry's points
+struct CollideBlock {
+    unsigned int geometry;
+    unsigned int begin;
+    unsigned int end;
+};
+
+} // namespace
+
+// Push the points [begin, end) of one geometry out of the sphere, blended by
+// env. toCollider takes them into the coordinate space of the locator, where
+// the sphere is the unit sphere at the origin. Returns how many moved.
+static unsigned int collideBlock(CollideGeometry &geometry, float env,
+                                 unsigned int begin, unsigned int end) {
+    MPointArray &points            = geometry.points;
+    const float(&toCollider)[4][3] = geometry.toCollider;
+    const float(&toLocal)[4][3]    = geometry.toLocal;
+
+    // Stage each chunk of points into float streams and test them all
+    // against the sphere without branching, then only push out (and write
+    // back) the ones inside it
+    alignas(64) float px[kChunkSize], py[kChunkSize], pz[kChunkSize];
+    alignas(64) float cx[kChunkSize], cy[kChunkSize], cz[kChunkSize];
+    alignas(64) float lengthSq[kChunkSize];
+    unsigned int inside[kChunkSize];
+    unsigned int moved = 0;
+
+    for (unsigned int chunk = begin; chunk < end; chunk += kChunkSize) {
+        unsigned int count = std::min(kChunkSize, end - chunk);
+        for (unsigned int kk = 0; kk < count; ++kk) {
+            const MPoint &point = points[chunk + kk];
+            px[kk]              = (float)point.x;
+            py[kk]              = (float)point.y;
+            pz[kk]              = (float)point.z;
+        }
+
+        for (unsigned int kk = 0; kk < count; ++kk) {
+            cx[kk] = px[kk] * toCollider[0][0] + py[kk] * toCollider[1][0] +
+                     pz[kk] * toCollider[2][0] + toCollider[3][0];
+            cy[kk] = px[kk] * toCollider[0][1] + py[kk] * toCollider[1][1] +
+                     pz[kk] * toCollider[2][1] + toCollider[3][1];
+            cz[kk] = px[kk] * toCollider[0][2] + py[kk] * toCollider[1][2] +
+                     pz[kk] * toCollider[2][2] + toCollider[3][2];
+
+            lengthSq[kk] = cx[kk] * cx[kk] + cy[kk] * cy[kk] + cz[kk] * cz[kk];
+        }
+
+        // Gather the points strictly inside the sphere. A point at the very
+        // centre has no direction to be pushed in, so it stays put.
+        unsigned int numInside = 0;
+        for (unsigned int kk = 0; kk < count; ++kk) {
+            inside[numInside] = kk;
+            numInside += lengthSq[kk] > 0.0f && lengthSq[kk] < 1.0f;
+        }
+
+        for (unsigned int ii = 0; ii < numInside; ++ii) {
+            // Normalize the point so that it is exactly 1 unit away from the
+            // origin, on the surface of the sphere, then put it back into
+            // local space
+            unsigned int kk = inside[ii];
+            float scale     = 1.0f / std::sqrt(lengthSq[kk]);
+            float x         = cx[kk] * scale;
+            float y         = cy[kk] * scale;
+            float z         = cz[kk] * scale;
+
+            float lx = x * toLocal[0][0] + y * toLocal[1][0] +
+                       z * toLocal[2][0] + toLocal[3][0];
+            float ly = x * toLocal[0][1] + y * toLocal[1][1] +
+                       z * toLocal[2][1] + toLocal[3][1];
+            float lz = x * toLocal[0][2] + y * toLocal[1][2] +
+                       z * toLocal[2][2] + toLocal[3][2];
+
+            MPoint &point = points[chunk + kk];
+            point.x += (lx - px[kk]) * env;
+            point.y += (ly - py[kk]) * env;
+            point.z += (lz - pz[kk]) * env;
+        }
+        moved += numInside;
+    }
+
+    return moved;
+}
+
+// Push the points [begin, end) of one geometry out of every sphere in grid,
+// blended by env. toCollider takes them into world space, where the grid is.
+// Returns how many moved.
+static unsigned int collideGridBlock(CollideGeometry &geometry,
+                                     const SphereGrid &grid, float env,
+                                     unsigned int begin, unsigned int end) {
+    MPointArray &points         = geometry.points;
+    const float(&toWorld)[4][3] = geometry.toCollider;
+    const float(&toLocal)[4][3] = geometry.toLocal;
+
+    // Stage each chunk into float streams and move it into world space in
+    // one go, then look each point up in the grid. Only points that were
+    // inside a sphere are written back.
+    alignas(64) float px[kChunkSize], py[kChunkSize], pz[kChunkSize];
+    alignas(64) float wx[kChunkSize], wy[kChunkSize], wz[kChunkSize];
+    unsigned int moved = 0;
+
+    for (unsigned int chunk = begin; chunk < end; chunk += kChunkSize) {
+        unsigned int count = std::min(kChunkSize, end - chunk);
+        for (unsigned int kk = 0; kk < count; ++kk) {
+            const MPoint &point = points[chunk + kk];
+            px[kk]              = (float)point.x;
+            py[kk]              = (float)point.y;
+            pz[kk]              = (float)point.z;
+        }
+
+        for (unsigned int kk = 0; kk < count; ++kk) {
+            wx[kk] = px[kk] * toWorld[0][0] + py[kk] * toWorld[1][0] +
+                     pz[kk] * toWorld[2][0] + toWorld[3][0];
+            wy[kk] = px[kk] * toWorld[0][1] + py[kk] * toWorld[1][1] +
+                     pz[kk] * toWorld[2][1] + toWorld[3][1];
+            wz[kk] = px[kk] * toWorld[0][2] + py[kk] * toWorld[1][2] +
+                     pz[kk] * toWorld[2][2] + toWorld[3][2];
+        }
+
+        for (unsigned int kk = 0; kk < count; ++kk) {
+            float x = wx[kk];
+            float y = wy[kk];
+            float z = wz[kk];
+            if (!grid.collide(x, y, z)) {
+                continue;
+            }
+
+            float lx = x * toLocal[0][0] + y * toLocal[1][0] +
+                       z * toLocal[2][0] + toLocal[3][0];
+            float ly = x * toLocal[0][1] + y * toLocal[1][1] +
+                       z * toLocal[2][1] + toLocal[3][1];
+            float lz = x * toLocal[0][2] + y * toLocal[1][2] +
+                       z * toLocal[2][2] + toLocal[3][2];
+
+            MPoint &point = points[chunk + kk];
+            point.x += (lx - px[kk]) * env;
+            point.y += (ly - py[kk]) * env;
+            point.z += (lz - pz[kk]) * env;
+            ++moved;
+        }
+    }
+
+    return moved;
+}
+
+MStatus SphereColliderDeformer::compute(const MPlug &plug, MDataBlock &data) {
+    if (!isDeformerOutput(plug, data)) {
+        return MPxDeformerNode::compute(plug, data);
+    }
+
     MStatus status;
 
-    float env                    = data.inputValue(envelope).asFloat();
+    // The collider is the same for every geometry, read it once
     MMatrix collideMatrix        = data.inputValue(aCollideMatrix).asMatrix();
     MMatrix collideMatrixInverse = collideMatrix.inverse();
-    MMatrix worldToLocalMatrix   = localToWorldMatrix.inverse();
-
-    MPoint point;
-    for (; !itGeo.isDone(); itGeo.next()) {
-        point = itGeo.position(); // These positions are in local space (always
-                                  // true for deform method)
-        point *= localToWorldMatrix; // Now point is in world space
-        point *=
-            collideMatrixInverse; // Put point into coordinate space of locator
-
-        // Measure length of point (remember we're now in coordinate space of
-        // locator)
-        float length = MVector(point).length();
-        if (length < 1.0f && length > 0.0f) {
-            // Point is within collider sphere
-
-            // Normalize point vector so that point is exactly 1 unit away from
-            // the origin. In a unit sphere this means that the point is forced
-            // to the edge of the sphere.
-            point = MVector(point).normal();
-
-            point *= collideMatrix;      // Put point back into world space
-            point *= worldToLocalMatrix; // Put point back into object space
-
-            itGeo.setPosition(point);
-        } else if (length == 0.0f) {
-            // Don't try to normalize vector of 0 length
-            return MS::kSuccess;
+    float env                    = data.inputValue(envelope).asFloat();
+
+    std::vector<DeformerGeometry> geometries;
+    status = gatherGeometries(thisMObject(), data, geometries);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+
+    // The outputs already hold copies of the inputs
+    if (env == 0.0f) {
+        return setGeometriesClean(data, geometries);
+    }
+
+    // Many spheres are binned into a grid each evaluation, shared by every
+    // geometry
+    MArrayDataHandle hCollideMatrices =
+        data.inputArrayValue(aCollideMatrices, &status);
+    CHECK_MSTATUS_AND_RETURN_IT(status);
+    std::vector<MMatrix> collideMatrices(hCollideMatrices.elementCount());
+    for (size_t ii = 0; ii < collideMatrices.size();
+         ++ii, hCollideMatrices.next()) {
+        collideMatrices[ii] = hCollideMatrices.inputValue().asMatrix();
+    }
+    SphereGrid grid;
+    grid.build(collideMatrices);
+    bool useGrid = !collideMatrices.empty();
+    if (useGrid && grid.isEmpty()) {
+        return setGeometriesClean(data, geometries);
+    }
+
+    // Get all the points of every geometry at once, in local space. The
+    // iterators are only used here on the main thread.
+    std::vector<CollideGeometry> collideGeometries(geometries.size());
+    std::vector<CollideBlock> blocks;
+    for (size_t gg = 0; gg < geometries.size(); ++gg) {
+        DeformerGeometry &geometry = geometries[gg];
+        CollideGeometry &collide   = collideGeometries[gg];
+        collide.itGeo.reset(new MItGeometry(geometry.hOutputGeom,
+                                            geometry.groupId, false, &status));
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+        status = collide.itGeo->allPositions(collide.points);
+        CHECK_MSTATUS_AND_RETURN_IT(status);
+
+        // One matrix takes points from local space, through world space, into
+        // the space they are collided in. Another takes them back.
+        const MMatrix &localToWorldMatrix = geometry.localToWorldMatrix;
+        if (useGrid) {
+            toFloatMatrix(localToWorldMatrix, collide.toCollider);
+            toFloatMatrix(localToWorldMatrix.inverse(), collide.toLocal);
+        } else {
+            toFloatMatrix(localToWorldMatrix * collideMatrixInverse,
+                          collide.toCollider);
+            toFloatMatrix(collideMatrix * localToWorldMatrix.inverse(),
+                          collide.toLocal);
+        }
+
+        unsigned int numPoints = collide.points.length();
+        for (unsigned int begin = 0; begin < numPoints;
+             begin += kMinBlockSize) {
+            CollideBlock block = {(unsigned int)gg, begin,
+                                  std::min(begin + kMinBlockSize, numPoints)};
+            blocks.push_back(block);
         }
     }
 
-    return MS::kSuccess;
+    // One parallel pass over the blocks of every geometry, so a few large
+    // meshes and many small ones both spread over the threads
+    std::vector<unsigned int> numMoved(blocks.size());
+    parallelFor(blocks.size(), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int bb = begin; bb < end; ++bb) {
+            const CollideBlock &block = blocks[bb];
+            CollideGeometry &collide  = collideGeometries[block.geometry];
+            numMoved[bb] =
+                useGrid ? collideGridBlock(collide, grid, env, block.begin,
+                                           block.end)
+                        : collideBlock(collide, env, block.begin, block.end);
+        }
+    });
+
+    // Write back, again on the main thread, only the geometries that had a
+    // point inside a sphere. The others' outputs already hold their inputs.
+    std::vector<bool> moved(collideGeometries.size(), false);
+    for (size_t bb = 0; bb < blocks.size(); ++bb) {
+        if (numMoved[bb] > 0) {
+            moved[blocks[bb].geometry] = true;
+        }
+    }
+    for (size_t gg = 0; gg < collideGeometries.size(); ++gg) {
+        if (moved[gg]) {
+            status = collideGeometries[gg].itGeo->setAllPositions(
+                collideGeometries[gg].points);
+            CHECK_MSTATUS_AND_RETURN_IT(status);
+        }
+    }
+
+    return setGeometriesClean(data, geometries);
 }
 
 // Return which attribute is our accessory attribute
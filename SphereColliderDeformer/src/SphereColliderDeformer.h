@@ -8,6 +8,7 @@
 #include <maya/MPointArray.h>
 #include <maya/MStatus.h>
 #include <maya/MDagModifier.h>
+#include <maya/MPlug.h>
 
 #include <maya/MFnMatrixAttribute.h>
 #include <maya/MFnMesh.h>
@@ -15,11 +16,21 @@
 
 #include <maya/MPxDeformerNode.h>
 
+#include "DeformerGeometry.h"
+#include "SphereGrid.h"
+
 /**
  * A node that allows you to deform a mesh by 'colliding' it with a sphere.
  *
  * Name:
- *   sphereCollide 
+ *   sphereCollide
+ *
+ * Attributes:
+ *   collideMatrix (col) - World matrix of the sphere, the unit sphere at the
+ *   origin in its space.
+ *   collideMatrices (cms) - World matrices of any number of spheres. When
+ *   any are given they are collided with instead of collideMatrix, through
+ *   a grid so each point only tests the spheres near it.
  */
 class SphereColliderDeformer : public MPxDeformerNode {
   public:
@@ -28,12 +39,11 @@ class SphereColliderDeformer : public MPxDeformerNode {
     static void *creator();
     static MStatus initialize();
 
-    virtual MStatus deform(MDataBlock &data, MItGeometry &itGeo,
-                           const MMatrix &localToWorldMatrix,
-                           unsigned int geomIndex) override;
+    virtual MStatus compute(const MPlug &plug, MDataBlock &data) override;
     virtual MObject &accessoryAttribute() const override;
     virtual MStatus accessoryNodeSetup(MDagModifier &dagModifier) override;
 
     static MTypeId id;
     static MObject aCollideMatrix;
+    static MObject aCollideMatrices;
 };
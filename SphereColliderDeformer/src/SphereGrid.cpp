@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "SphereGrid.h"
+
+// Most cells the grid is allowed, the cells get bigger rather than the grid
+// using more memory
+static const double kMaxCells = 262144.0;
+// Matrices with a determinant this small have no usable inverse
+static const double kMinDeterminant = 1e-12;
+
+namespace {
+
+// World space bounds of the unit sphere transformed by matrix
+void sphereBounds(const MMatrix &matrix, double minimum[3],
+                  double maximum[3]) {
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        double radius = std::sqrt(matrix(0, axis) * matrix(0, axis) +
+                                  matrix(1, axis) * matrix(1, axis) +
+                                  matrix(2, axis) * matrix(2, axis));
+        minimum[axis] = matrix(3, axis) - radius;
+        maximum[axis] = matrix(3, axis) + radius;
+    }
+}
+
+} // namespace
+
+void SphereGrid::build(const std::vector<MMatrix> &matrices) {
+    m_spheres.clear();
+    m_cellStarts.clear();
+    m_cellSpheres.clear();
+
+    std::vector<double> bounds;
+    double gridMinimum[3], gridMaximum[3];
+    double totalSize = 0.0;
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        gridMinimum[axis] = std::numeric_limits<double>::max();
+        gridMaximum[axis] = -std::numeric_limits<double>::max();
+    }
+    for (size_t ii = 0; ii < matrices.size(); ++ii) {
+        const MMatrix &matrix = matrices[ii];
+        if (std::fabs(matrix.det3x3()) < kMinDeterminant) {
+            continue;
+        }
+
+        Sphere sphere;
+        toFloatMatrix(matrix.inverse(), sphere.toSphere);
+        toFloatMatrix(matrix, sphere.toWorld);
+        m_spheres.push_back(sphere);
+
+        double minimum[3], maximum[3];
+        sphereBounds(matrix, minimum, maximum);
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            gridMinimum[axis] = std::min(gridMinimum[axis], minimum[axis]);
+            gridMaximum[axis] = std::max(gridMaximum[axis], maximum[axis]);
+            totalSize += maximum[axis] - minimum[axis];
+            bounds.push_back(minimum[axis]);
+            bounds.push_back(maximum[axis]);
+        }
+    }
+    unsigned int numSpheres = (unsigned int)m_spheres.size();
+    if (numSpheres == 0) {
+        return;
+    }
+
+    // Cells about the size of an average sphere keep the number of spheres
+    // per cell small, unless the spheres are spread out so far that there
+    // would be too many cells
+    double cellSize = totalSize / (3.0 * numSpheres);
+    double dims[3];
+    while (true) {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            dims[axis] = std::max(
+                1.0, std::ceil((gridMaximum[axis] - gridMinimum[axis]) /
+                               cellSize));
+        }
+        if (dims[0] * dims[1] * dims[2] <= kMaxCells) {
+            break;
+        }
+        cellSize *= 1.5;
+    }
+    m_invCellSize = (float)(1.0 / cellSize);
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        m_origin[axis] = (float)gridMinimum[axis];
+        m_dims[axis]   = (int)dims[axis];
+    }
+
+    // Count the spheres overlapping each cell, then fill them in, so each
+    // cell's spheres end up contiguous and in ascending order
+    unsigned int numCells = m_dims[0] * m_dims[1] * m_dims[2];
+    m_cellStarts.assign(numCells + 1, 0);
+    for (int pass = 0; pass < 2; ++pass) {
+        for (unsigned int ii = 0; ii < numSpheres; ++ii) {
+            int lower[3], upper[3];
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                double minimum = bounds[ii * 6 + axis * 2];
+                double maximum = bounds[ii * 6 + axis * 2 + 1];
+                lower[axis]    = std::min(
+                    m_dims[axis] - 1,
+                    (int)((minimum - gridMinimum[axis]) / cellSize));
+                upper[axis] = std::min(
+                    m_dims[axis] - 1,
+                    (int)((maximum - gridMinimum[axis]) / cellSize));
+            }
+
+            for (int cz = lower[2]; cz <= upper[2]; ++cz) {
+                for (int cy = lower[1]; cy <= upper[1]; ++cy) {
+                    for (int cx = lower[0]; cx <= upper[0]; ++cx) {
+                        unsigned int cell =
+                            (cz * m_dims[1] + cy) * m_dims[0] + cx;
+                        if (pass == 0) {
+                            ++m_cellStarts[cell + 1];
+                        } else {
+                            m_cellSpheres[m_cellStarts[cell]++] = ii;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (unsigned int cell = 0; cell < numCells; ++cell) {
+                m_cellStarts[cell + 1] += m_cellStarts[cell];
+            }
+            m_cellSpheres.resize(m_cellStarts[numCells]);
+        } else {
+            // Filling moved each start on to the next cell's
+            for (unsigned int cell = numCells; cell > 0; --cell) {
+                m_cellStarts[cell] = m_cellStarts[cell - 1];
+            }
+            m_cellStarts[0] = 0;
+        }
+    }
+}
+
+bool SphereGrid::collide(float &x, float &y, float &z) const {
+    if (m_spheres.empty()) {
+        return false;
+    }
+
+    // Points outside the grid can't be inside any sphere
+    float p[3] = {x, y, z};
+    int cell[3];
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        float position = (p[axis] - m_origin[axis]) * m_invCellSize;
+        if (!(position >= 0.0f) || position >= (float)m_dims[axis]) {
+            return false;
+        }
+        cell[axis] = std::min((int)position, m_dims[axis] - 1);
+    }
+    unsigned int index = (cell[2] * m_dims[1] + cell[1]) * m_dims[0] + cell[0];
+
+    bool moved = false;
+    for (unsigned int ii = m_cellStarts[index]; ii < m_cellStarts[index + 1];
+         ++ii) {
+        const Sphere &sphere = m_spheres[m_cellSpheres[ii]];
+        const float(*m)[3]   = sphere.toSphere;
+        float sx = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+        float sy = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+        float sz = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+
+        // A point at the very centre has no direction to be pushed in
+        float lengthSq = sx * sx + sy * sy + sz * sz;
+        if (!(lengthSq > 0.0f && lengthSq < 1.0f)) {
+            continue;
+        }
+        float scale = 1.0f / std::sqrt(lengthSq);
+        sx *= scale;
+        sy *= scale;
+        sz *= scale;
+
+        m     = sphere.toWorld;
+        x     = sx * m[0][0] + sy * m[1][0] + sz * m[2][0] + m[3][0];
+        y     = sx * m[0][1] + sy * m[1][1] + sz * m[2][1] + m[3][1];
+        z     = sx * m[0][2] + sy * m[1][2] + sz * m[2][2] + m[3][2];
+        moved = true;
+    }
+    return moved;
+}
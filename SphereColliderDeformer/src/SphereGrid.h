@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include <maya/MMatrix.h>
+
+/**
+ * The affine part of a matrix as floats, for transforming float streams.
+ */
+inline void toFloatMatrix(const MMatrix &matrix, float m[4][3]) {
+    for (unsigned int row = 0; row < 4; ++row) {
+        for (unsigned int column = 0; column < 3; ++column) {
+            m[row][column] = (float)matrix(row, column);
+        }
+    }
+}
+
+/**
+ * A set of sphere colliders binned into a uniform grid, for pushing points
+ * out of many spheres without testing every point against every sphere.
+ *
+ * Each sphere is the unit sphere at the origin transformed by a matrix, so
+ * it may be scaled into an ellipsoid. The grid covers the world space bounds
+ * of all the spheres and each cell lists (in ascending order) the spheres
+ * whose bounding boxes overlap it, stored as one flat array with a start
+ * offset per cell. Points outside the grid are rejected straight away.
+ */
+class SphereGrid {
+  public:
+    SphereGrid() : m_invCellSize(0.0f){};
+
+    /**
+     * Bin the spheres with the given world matrices, replacing any previous
+     * spheres. Spheres with singular matrices are left out.
+     */
+    void build(const std::vector<MMatrix> &matrices);
+
+    bool isEmpty() const { return m_spheres.empty(); }
+
+    /**
+     * Push a world space point out of each sphere in its cell that it is
+     * strictly inside of, in sphere order. Returns whether the point moved.
+     */
+    bool collide(float &x, float &y, float &z) const;
+
+  private:
+    struct Sphere {
+        // World space to the sphere's space and back, affine parts only
+        float toSphere[4][3];
+        float toWorld[4][3];
+    };
+
+    std::vector<Sphere> m_spheres;
+    // Corner of the grid, number of cells along each axis and the inverse of
+    // the cell size
+    float m_origin[3];
+    int m_dims[3];
+    float m_invCellSize;
+    // Spheres overlapping cell c are m_cellSpheres[m_cellStarts[c]] up to
+    // m_cellSpheres[m_cellStarts[c + 1]]
+    std::vector<unsigned int> m_cellStarts;
+    std::vector<unsigned int> m_cellSpheres;
+};